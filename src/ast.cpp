@@ -1,5 +1,10 @@
 #include "ast.hpp"
 
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
 MimRegex Conjunction::generateMimIR(MimirCodeGen& code_gen) const {
 
     if (children.empty()) {
@@ -20,6 +25,62 @@ MimRegex Conjunction::generateMimIR(MimirCodeGen& code_gen) const {
 
 }
 
+uint32_t Conjunction::generatePike(PikeProgram& program, uint32_t next) const {
+
+    // back to front, every match continues with the one after it
+    for (auto it = children.rbegin(); it != children.rend(); ++it) {
+        next = (*it)->generatePike(program, next);
+    }
+
+    return next;
+
+}
+
+LiteralInfo Conjunction::extractLiterals() const {
+
+    std::vector<LiteralInfo> pieces;
+    for (const Match* child : children) {
+        pieces.push_back(child->extractLiterals());
+    }
+
+    return LiteralInfo::concatenate(pieces);
+
+}
+
+LengthBounds Conjunction::lengthBounds() const {
+
+    LengthBounds bounds = LengthBounds::exactly(0);
+    for (const Match* child : children) {
+        bounds = bounds.then(child->lengthBounds());
+    }
+
+    return bounds;
+
+}
+
+EdgeBytes Conjunction::edgeBytes() const {
+
+    EdgeBytes edges;
+    for (const Match* child : children) {
+        edges = edges.then(child->edgeBytes());
+    }
+
+    return edges;
+
+}
+
+bool Conjunction::appendShape(std::vector<ShapePiece>& shape) const {
+
+    for (const Match* child : children) {
+        if (!child->appendShape(shape)) {
+            return false;
+        }
+    }
+
+    return true;
+
+}
+
 MimRegex Expression::generateMimIR(MimirCodeGen& code_gen) const {
 
     if (children.empty()) {
@@ -39,110 +100,241 @@ MimRegex Expression::generateMimIR(MimirCodeGen& code_gen) const {
 
 }
 
-MimRegex characterClassToRegex(MimirCodeGen& code_gen, const CharacterClass cls) {
+uint32_t Expression::generatePike(PikeProgram& program, const uint32_t next) const {
 
-    switch (cls) {
+    if (children.empty()) {
+        return next;
+    }
+
+    std::vector<uint32_t> alternatives;
+    for (const Conjunction* conj : children) {
+        alternatives.push_back(conj->generatePike(program, next));
+    }
 
-        case CharacterClass::WordChars: {
-            const MimRegex az = code_gen.regex_range(code_gen.char_lit('a'), code_gen.char_lit('z'));
-            const MimRegex az_cap = code_gen.regex_range(code_gen.char_lit('A'), code_gen.char_lit('Z'));
-            const MimRegex digits = code_gen.regex_range(code_gen.char_lit('0'), code_gen.char_lit('9'));
-            const MimRegex underscore = code_gen.regex_lit('_');
-            return code_gen.regex_disj({az, az_cap, digits, underscore});
+    uint32_t first = alternatives.back();
+    for (size_t i = alternatives.size() - 1; i-- > 0;) {
+        first = program.emit_split(alternatives[i], first);
+    }
+
+    return first;
+
+}
+
+PikeProgram Expression::generatePikeProgram() const {
+
+    PikeProgram program;
+    program.set_start(generatePike(program, PikeProgram::match()));
+
+    return program;
+
+}
+
+MatcherSource Expression::generateMatcherSource(MimirCodeGen& code_gen) const {
+    std::string key;
+    appendKey(key);
+    return MatcherSource{generateMimIR(code_gen), generatePikeProgram(), std::move(key)};
+}
+
+LiteralInfo Expression::extractLiterals() const {
+
+    if (children.empty()) {
+        return LiteralInfo::empty_string();
+    }
+
+    std::vector<LiteralInfo> alternatives;
+    for (const Conjunction* conj : children) {
+        alternatives.push_back(conj->extractLiterals());
+    }
+
+    return LiteralInfo::alternate(alternatives);
+
+}
+
+LengthBounds Expression::lengthBounds() const {
+
+    if (children.empty()) {
+        return LengthBounds::exactly(0);
+    }
+
+    LengthBounds bounds = children[0]->lengthBounds();
+    for (size_t i = 1; i < children.size(); i++) {
+        bounds = bounds.either(children[i]->lengthBounds());
+    }
+
+    return bounds;
+
+}
+
+EdgeBytes Expression::edgeBytes() const {
+
+    if (children.empty()) {
+        return EdgeBytes();
+    }
+
+    EdgeBytes edges = children[0]->edgeBytes();
+    for (size_t i = 1; i < children.size(); i++) {
+        edges = edges.either(children[i]->edgeBytes());
+    }
+
+    return edges;
+
+}
+
+bool Expression::appendShape(std::vector<ShapePiece>& shape) const {
+
+    if (children.size() > 1) {
+        return false;
+    }
+
+    return children.empty() || children[0]->appendShape(shape);
+
+}
+
+std::optional<std::vector<ShapePiece>> Expression::shape() const {
+
+    std::vector<ShapePiece> shape;
+    if (!appendShape(shape)) {
+        return std::nullopt;
+    }
+
+    return shape;
+
+}
+
+MimRegex byteSetToRegex(MimirCodeGen& code_gen, const ByteSet& bytes) {
+
+    if (bytes == ByteSet::all()) {
+        return code_gen.regex_any();
+    }
+
+    // Ranges are split at 0x80, so that each one is ordered whether MimIR compares its i8 bounds signed or unsigned.
+    std::vector<MimRegex> regexes;
+    const auto add = [&](const unsigned char lower, const unsigned char upper) {
+        if (lower == upper) {
+            regexes.push_back(code_gen.regex_lit(static_cast<char>(lower)));
         }
+        else {
+            regexes.push_back(code_gen.regex_range(code_gen.char_lit(static_cast<char>(lower)),
+                                                   code_gen.char_lit(static_cast<char>(upper))));
+        }
+    };
 
-        case CharacterClass::NonWordChars: {
-            const MimRegex r1 = code_gen.regex_range(code_gen.char_lit(0x00), code_gen.char_lit(0x2f));
-            const MimRegex r2 = code_gen.regex_range(code_gen.char_lit(0x3a), code_gen.char_lit(0x40));
-            const MimRegex r3 = code_gen.regex_range(code_gen.char_lit(0x5b), code_gen.char_lit(0x5e));
-            const MimRegex r4 = code_gen.regex_lit(0x60);
-            const MimRegex r5 = code_gen.regex_range(code_gen.char_lit(0x7b), code_gen.char_lit(0x7f));
-            return code_gen.regex_disj({r1, r2, r3, r4, r5});
+    bytes.for_each_range([&](const unsigned char lower, const unsigned char upper) {
+        if (lower < 0x80 && upper >= 0x80) {
+            add(lower, 0x7f);
+            add(0x80, upper);
+        }
+        else {
+            add(lower, upper);
         }
+    });
+
+    // no byte at all, e.g. for "[^\\x00-\\xff]"
+    if (regexes.empty()) {
+        return code_gen.regex_not(code_gen.regex_any());
+    }
+
+    if (regexes.size() == 1) {
+        return regexes[0];
+    }
+
+    return code_gen.regex_disj(regexes);
+
+}
+
+ByteSet characterClassToByteSet(const CharacterClass cls) {
+
+    ByteSet bytes;
+
+    switch (cls) {
+
+        case CharacterClass::WordChars:
+            bytes.insert_range('a', 'z');
+            bytes.insert_range('A', 'Z');
+            bytes.insert_range('0', '9');
+            bytes.insert('_');
+            break;
+
+        case CharacterClass::NonWordChars:
+            bytes.insert_range(0x00, 0x2f);
+            bytes.insert_range(0x3a, 0x40);
+            bytes.insert_range(0x5b, 0x5e);
+            bytes.insert(0x60);
+            bytes.insert_range(0x7b, 0x7f);
+            break;
 
         case CharacterClass::DigitChars:
-            return code_gen.regex_range(code_gen.char_lit('0'), code_gen.char_lit('9'));
+            bytes.insert_range('0', '9');
+            break;
 
-        case CharacterClass::NonDigitChars: {
-            const MimRegex r1 = code_gen.regex_range(code_gen.char_lit(0x00), code_gen.char_lit(0x2f));
-            const MimRegex r2 = code_gen.regex_range(code_gen.char_lit(0x3a), code_gen.char_lit(0x7f));
-            return code_gen.regex_disj({r1, r2});
-        }
+        case CharacterClass::NonDigitChars:
+            bytes.insert_range(0x00, 0x2f);
+            bytes.insert_range(0x3a, 0x7f);
+            break;
 
         case CharacterClass::WhiteSpaceChars:
-            return code_gen.regex_disj({
-                code_gen.regex_lit(' '),
-                code_gen.regex_lit('\n'),
-                code_gen.regex_lit('\r'),
-                code_gen.regex_lit('\t'),
-                code_gen.regex_lit('\v'),
-                code_gen.regex_lit('\f')
-            });
-
-        case CharacterClass::NonWhiteSpaceChars: {
-            const MimRegex r1 = code_gen.regex_range(code_gen.char_lit(0x00), code_gen.char_lit(0x08));
-            const MimRegex r2 = code_gen.regex_range(code_gen.char_lit(0x0e), code_gen.char_lit(0x1f));
-            const MimRegex r3 = code_gen.regex_range(code_gen.char_lit(0x21), code_gen.char_lit(0x7f));
-            return code_gen.regex_disj({r1, r2, r3});
-        }
+            for (const char c : {' ', '\n', '\r', '\t', '\v', '\f'}) {
+                bytes.insert(c);
+            }
+            break;
+
+        case CharacterClass::NonWhiteSpaceChars:
+            bytes.insert_range(0x00, 0x08);
+            bytes.insert_range(0x0e, 0x1f);
+            bytes.insert_range(0x21, 0x7f);
+            break;
 
         default:
             assert(false);
     }
+
+    return bytes;
+
 }
 
-MimRegex CharacterSet::generateMimIR(MimirCodeGen& code_gen, const bool negate, const bool addClosingBracket) const {
+ByteSet CharacterSet::toByteSet(const bool negate, const bool addClosingBracket) const {
 
-    std::vector<MimRegex> regexes;
+    ByteSet bytes;
 
     if (addClosingBracket) {
-        regexes.push_back(code_gen.regex_lit(']'));
+        bytes.insert(']');
     }
 
     for (const CharacterRange* range : ranges) {
-        regexes.push_back(range->generateMimIR(code_gen));
+        range->addTo(bytes);
     }
 
     for (const CharacterClass cls : classes) {
-        regexes.push_back(characterClassToRegex(code_gen, cls));
+        bytes |= characterClassToByteSet(cls);
     }
 
-    assert(!regexes.empty());
-
-    const MimRegex result = code_gen.regex_disj(regexes);
-    return negate ? code_gen.regex_not(result) : result;
+    return negate ? bytes.complement() : bytes;
 
 }
 
-MimRegex CharacterClassMatchElement::generateMimIR(MimirCodeGen& code_gen) const {
-    return characterClassToRegex(code_gen, char_class);
-}
+static ByteSet bracketToByteSet(const CharacterAltType type, const CharacterSet* set) {
 
-MimRegex CharacterAlt::generateMimIR(MimirCodeGen& code_gen) const {
+    const bool negated_mode = type == CharacterAltType::Negated || type == CharacterAltType::NegatedIncludingClosingBracket;
+    const bool include_closing_bracket = type == CharacterAltType::NormalIncludingClosingBracket || type == CharacterAltType::NegatedIncludingClosingBracket;
 
     if (set == nullptr) {
-        switch (type) {
-            case CharacterAltType::NormalIncludingClosingBracket:
-                return code_gen.regex_lit(']');
-            case CharacterAltType::NegatedIncludingClosingBracket:
-                return code_gen.regex_not(code_gen.regex_lit(']'));
-            default:
-                assert(false);
-        }
+        assert(include_closing_bracket);
+        ByteSet bytes;
+        bytes.insert(']');
+        return negated_mode ? bytes.complement() : bytes;
     }
 
-    const bool negated_mode = type == CharacterAltType::Negated || type == CharacterAltType::NegatedIncludingClosingBracket;
-    const bool include_closing_bracket = type == CharacterAltType::NormalIncludingClosingBracket || type == CharacterAltType::NegatedIncludingClosingBracket;
-
-    return set->generateMimIR(code_gen, negated_mode, include_closing_bracket);
+    return set->toByteSet(negated_mode, include_closing_bracket);
 
 }
 
+CharacterAlt::CharacterAlt(const CharacterAltType type, const CharacterSet* set) : bytes(bracketToByteSet(type, set)) {}
+
 MimRegex Match::generateMimIR(MimirCodeGen& code_gen) const {
 
     const MimRegex elementRegex = element->generateMimIR(code_gen);
 
-    if (quantifier == nullptr) {
+    if (!quantifier) {
         return elementRegex;
     }
 
@@ -158,3 +350,456 @@ MimRegex Match::generateMimIR(MimirCodeGen& code_gen) const {
     }
 
 }
+
+uint32_t Match::generatePike(PikeProgram& program, const uint32_t next) const {
+
+    if (!quantifier) {
+        return element->generatePike(program, next);
+    }
+
+    switch (*quantifier) {
+        case Quantifier::Star: {
+            // the loop either runs the element once more or leaves
+            const uint32_t loop = program.reserve_split();
+            program.set_split(loop, element->generatePike(program, loop), next);
+            return loop;
+        }
+        case Quantifier::Plus: {
+            const uint32_t loop = program.reserve_split();
+            const uint32_t body = element->generatePike(program, loop);
+            program.set_split(loop, body, next);
+            return body;
+        }
+        case Quantifier::QuestionMark:
+            return program.emit_split(element->generatePike(program, next), next);
+        default:
+            assert(false);
+    }
+
+}
+
+LiteralInfo Match::extractLiterals() const {
+
+    const LiteralInfo info = element->extractLiterals();
+
+    if (!quantifier) {
+        return info;
+    }
+
+    switch (*quantifier) {
+        case Quantifier::Star:
+            return info.star();
+        case Quantifier::Plus:
+            return info.plus();
+        case Quantifier::QuestionMark:
+            return info.optional();
+        default:
+            assert(false);
+    }
+
+}
+
+LengthBounds Match::lengthBounds() const {
+
+    const LengthBounds bounds = element->lengthBounds();
+
+    if (!quantifier) {
+        return bounds;
+    }
+
+    switch (*quantifier) {
+        case Quantifier::Star:
+            return bounds.repeated(0);
+        case Quantifier::Plus:
+            return bounds.repeated(1);
+        case Quantifier::QuestionMark:
+            return bounds.optional();
+        default:
+            assert(false);
+    }
+
+}
+
+EdgeBytes Match::edgeBytes() const {
+
+    const EdgeBytes edges = element->edgeBytes();
+
+    if (!quantifier) {
+        return edges;
+    }
+
+    switch (*quantifier) {
+        case Quantifier::Star:
+            return edges.repeated(0);
+        case Quantifier::Plus:
+            return edges.repeated(1);
+        case Quantifier::QuestionMark:
+            return edges.optional();
+        default:
+            assert(false);
+    }
+
+}
+
+bool Match::appendShape(std::vector<ShapePiece>& shape) const {
+
+    if (!quantifier) {
+        return element->appendShape(shape);
+    }
+
+    // only a single byte can be quantified, e.g. not "(ab)*"
+    std::vector<ShapePiece> pieces;
+    if (!element->appendShape(pieces) || pieces.size() != 1 || pieces[0].optional || pieces[0].repeated) {
+        return false;
+    }
+
+    ShapePiece piece = pieces[0];
+    piece.optional = *quantifier != Quantifier::Plus;
+    piece.repeated = *quantifier != Quantifier::QuestionMark;
+    shape.push_back(piece);
+
+    return true;
+
+}
+
+// The key of an element: the sets of single bytes as their ranges, groups as the key of their regex.
+static void appendElementKey(const MatchElement* element, std::string& key) {
+
+    if (const std::optional<ByteSet> bytes = element->singleByte()) {
+        bytes->for_each_range([&key](const unsigned char lower, const unsigned char upper) {
+            key += 'r';
+            key += static_cast<char>(lower);
+            key += static_cast<char>(upper);
+        });
+        key += 'b';
+        return;
+    }
+
+    key += '(';
+    element->asGroup()->body()->appendKey(key);
+    key += ')';
+
+}
+
+static std::string elementKey(const MatchElement* element) {
+    std::string key;
+    appendElementKey(element, key);
+    return key;
+}
+
+// The quantifier of a quantified piece that is quantified again, e.g. "*" for "(a+)?".
+static std::optional<Quantifier> combine(const std::optional<Quantifier> outer, const std::optional<Quantifier> inner) {
+
+    if (!outer || !inner || outer == inner) {
+        return outer ? outer : inner;
+    }
+
+    return Quantifier::Star;
+
+}
+
+Match* Match::optimize(AstArena& arena) const {
+
+    const MatchElement* optimized = element->optimize(arena);
+    const Group* group = optimized->asGroup();
+
+    if (group == nullptr) {
+        return arena.make<Match>(optimized, quantifier);
+    }
+
+    const std::pmr::vector<Conjunction*>& alternatives = group->body()->alternatives();
+
+    // "()*" only matches the empty text, which the conjunction drops
+    if (alternatives.empty() || (alternatives.size() == 1 && alternatives[0]->matches().empty())) {
+        return arena.make<Match>(optimized);
+    }
+
+    // "((a))" is "a", and "(a+)*" is "a*"
+    if (alternatives.size() == 1 && alternatives[0]->matches().size() == 1) {
+        const Match* inner = alternatives[0]->matches()[0];
+        return arena.make<Match>(inner->element, combine(quantifier, inner->quantifier));
+    }
+
+    return arena.make<Match>(optimized, quantifier);
+
+}
+
+Match* Match::optional(AstArena& arena) const {
+    return arena.make<Match>(element, combine(Quantifier::QuestionMark, quantifier));
+}
+
+Match* Match::merge(AstArena& arena, const Match& match, const Match& next) {
+
+    const std::optional<Quantifier> first = match.quantifier;
+    const std::optional<Quantifier> second = next.quantifier;
+
+    std::optional<Quantifier> merged;
+
+    if (first == Quantifier::Star || second == Quantifier::Star) {
+        // "a*a*" and "a*a?" are "a*", while "a*a+" and "aa*" are "a+"
+        const std::optional<Quantifier> other = first == Quantifier::Star ? second : first;
+        merged = other == Quantifier::Star || other == Quantifier::QuestionMark ? Quantifier::Star : Quantifier::Plus;
+    }
+    else if ((first == Quantifier::Plus && second == Quantifier::QuestionMark) ||
+             (first == Quantifier::QuestionMark && second == Quantifier::Plus)) {
+        merged = Quantifier::Plus;
+    }
+    else {
+        // e.g. "a+a+" needs two "a"s, and "a?a?" matches "aa"
+        return nullptr;
+    }
+
+    if (elementKey(match.element) != elementKey(next.element)) {
+        return nullptr;
+    }
+
+    return arena.make<Match>(match.element, merged);
+
+}
+
+std::optional<ByteSet> Match::singleByte() const {
+    return !quantifier ? element->singleByte() : std::nullopt;
+}
+
+const Expression* Match::plainGroup() const {
+
+    const Group* group = element->asGroup();
+
+    return !quantifier && group != nullptr ? group->body() : nullptr;
+
+}
+
+void Match::appendKey(std::string& key) const {
+
+    appendElementKey(element, key);
+
+    if (!quantifier) {
+        key += '-';
+        return;
+    }
+
+    switch (*quantifier) {
+        case Quantifier::Star:
+            key += '*';
+            break;
+        case Quantifier::Plus:
+            key += '+';
+            break;
+        case Quantifier::QuestionMark:
+            key += '?';
+            break;
+        default:
+            assert(false);
+    }
+
+}
+
+Conjunction* Conjunction::optimize(AstArena& arena) const {
+
+    auto* conj = arena.make<Conjunction>();
+    for (const Match* child : children) {
+        conj->appendOptimized(arena, child->optimize(arena));
+    }
+
+    return conj;
+
+}
+
+void Conjunction::appendOptimized(AstArena& arena, Match* match) {
+
+    const Expression* group = match->plainGroup();
+
+    if (group != nullptr && group->alternatives().size() <= 1) {
+        if (!group->alternatives().empty()) {
+            for (Match* child : group->alternatives()[0]->matches()) {
+                appendOptimized(arena, child);
+            }
+        }
+        return;
+    }
+
+    // the merged match may merge with the one before, e.g. "a?" and "a" and "a*"
+    if (!children.empty()) {
+        if (Match* merged = Match::merge(arena, *children.back(), *match)) {
+            children.pop_back();
+            appendOptimized(arena, merged);
+            return;
+        }
+    }
+
+    children.push_back(match);
+
+}
+
+std::optional<ByteSet> Conjunction::singleByte() const {
+    return children.size() == 1 ? children[0]->singleByte() : std::nullopt;
+}
+
+const Expression* Conjunction::plainGroup() const {
+    return children.size() == 1 ? children[0]->plainGroup() : nullptr;
+}
+
+void Conjunction::appendKey(std::string& key) const {
+
+    key += '<';
+    for (const Match* child : children) {
+        child->appendKey(key);
+    }
+    key += '>';
+
+}
+
+static std::string conjunctionKey(const Conjunction* conj) {
+    std::string key;
+    conj->appendKey(key);
+    return key;
+}
+
+// Replaces the alternatives starting with the same match by that match followed by a group of the rest of them,
+// e.g. "abc|abd|e" by "a(bc|bd)|e", which optimizing the group turns into "ab[cd]|e". The same for suffixes.
+static std::vector<Conjunction*> factor(AstArena& arena, const std::vector<Conjunction*>& alternatives,
+                                        const bool suffixes) {
+
+    // the alternatives by the key of their first or last match, in the order they first appear
+    std::vector<std::vector<Conjunction*>> groups;
+    std::unordered_map<std::string, size_t> group_of_key;
+
+    for (Conjunction* conj : alternatives) {
+        if (conj->matches().empty()) {
+            groups.push_back({conj});
+            continue;
+        }
+        std::string key;
+        (suffixes ? conj->matches().back() : conj->matches().front())->appendKey(key);
+        const auto [it, inserted] = group_of_key.try_emplace(std::move(key), groups.size());
+        if (inserted) {
+            groups.emplace_back();
+        }
+        groups[it->second].push_back(conj);
+    }
+
+    std::vector<Conjunction*> factored;
+
+    for (const std::vector<Conjunction*>& group : groups) {
+
+        if (group.size() == 1) {
+            factored.push_back(group[0]);
+            continue;
+        }
+
+        auto* rests = arena.make<Expression>();
+        for (const Conjunction* conj : group) {
+            const std::pmr::vector<Match*>& matches = conj->matches();
+            auto* rest = arena.make<Conjunction>();
+            for (size_t i = suffixes ? 0 : 1; i < matches.size() - (suffixes ? 1 : 0); i++) {
+                rest->add_child(matches[i]);
+            }
+            rests->add_child(rest);
+        }
+
+        Match* const edge = suffixes ? group[0]->matches().back() : group[0]->matches().front();
+        Match* const rest = Match(arena.make<GroupMatchElement>(arena.make<Group>(true, rests))).optimize(arena);
+
+        auto* conj = arena.make<Conjunction>();
+        conj->appendOptimized(arena, suffixes ? rest : edge);
+        conj->appendOptimized(arena, suffixes ? edge : rest);
+        factored.push_back(conj);
+
+    }
+
+    return factored;
+
+}
+
+// Drops duplicate alternatives, folds those of single bytes into one set and factors out common prefixes and
+// suffixes, see Expression::optimize.
+static std::vector<Conjunction*> simplifyAlternatives(AstArena& arena, std::vector<Conjunction*> alternatives) {
+
+    // a single alternative has nothing to be compared with
+    if (alternatives.size() < 2) {
+        return alternatives;
+    }
+
+    // duplicates
+    std::unordered_set<std::string> keys;
+    std::erase_if(alternatives, [&keys](const Conjunction* conj) {
+        return !keys.insert(conjunctionKey(conj)).second;
+    });
+
+    // single bytes, which are folded into the first of them
+    ByteSet bytes;
+    size_t first_byte = alternatives.size();
+    size_t byte_count = 0;
+
+    for (size_t i = 0; i < alternatives.size(); i++) {
+        if (const std::optional<ByteSet> single = alternatives[i]->singleByte()) {
+            bytes |= *single;
+            first_byte = std::min(first_byte, i);
+            byte_count++;
+        }
+    }
+
+    if (byte_count > 1) {
+        std::vector<Conjunction*> folded;
+        for (size_t i = 0; i < alternatives.size(); i++) {
+            if (i == first_byte) {
+                const auto* element = arena.make<CharacterAltMatchElement>(arena.make<CharacterAlt>(bytes));
+                folded.push_back(arena.make<Conjunction>(arena.make<Match>(element)));
+            }
+            else if (!alternatives[i]->singleByte()) {
+                folded.push_back(alternatives[i]);
+            }
+        }
+        alternatives = std::move(folded);
+    }
+
+    return factor(arena, factor(arena, alternatives, false), true);
+
+}
+
+Expression* Expression::optimize(AstArena& arena) const {
+
+    // the optimized alternatives, with those of groups making up an alternative spliced in, e.g. for "(a|b)|c"
+    std::vector<Conjunction*> alternatives;
+
+    for (const Conjunction* child : children) {
+        Conjunction* conj = child->optimize(arena);
+        const Expression* group = conj->plainGroup();
+        if (group == nullptr) {
+            alternatives.push_back(conj);
+        }
+        else if (group->alternatives().empty()) {
+            alternatives.push_back(arena.make<Conjunction>());
+        }
+        else {
+            alternatives.insert(alternatives.end(), group->alternatives().begin(), group->alternatives().end());
+        }
+    }
+
+    alternatives = simplifyAlternatives(arena, std::move(alternatives));
+
+    // "(|ab)" is "(ab)?", and "(|a+)" is "a*"
+    if (alternatives.size() == 2 && (alternatives[0]->matches().empty() || alternatives[1]->matches().empty())) {
+        Conjunction* other = alternatives[0]->matches().empty() ? alternatives[1] : alternatives[0];
+        const Match* match = other->matches().size() == 1
+            ? other->matches()[0]
+            : arena.make<Match>(arena.make<GroupMatchElement>(arena.make<Group>(true, arena.make<Expression>(other))));
+        alternatives = {arena.make<Conjunction>(match->optional(arena))};
+    }
+
+    auto* expression = arena.make<Expression>();
+    for (Conjunction* conj : alternatives) {
+        expression->add_child(conj);
+    }
+
+    return expression;
+
+}
+
+void Expression::appendKey(std::string& key) const {
+
+    for (const Conjunction* child : children) {
+        child->appendKey(key);
+    }
+
+}
@@ -1,13 +1,27 @@
 #pragma once
+#include <memory_resource>
+#include <optional>
+#include <string>
 #include <vector>
 
+#include "ast_arena.hpp"
+#include "byte_set.hpp"
+#include "edge_bytes.hpp"
+#include "fast_path.hpp"
+#include "length_bounds.hpp"
+#include "literals.hpp"
 #include "mimir_codegen.hpp"
+#include "pike_vm.hpp"
 
+// The nodes of an AST are made in an AstArena and freed with it, see parse_regex.
 class AstNode {
 public:
     virtual ~AstNode() = default;
 };
 
+class Expression;
+class Group;
+
 enum class Quantifier {
     Star,
     Plus,
@@ -19,46 +33,129 @@ class MatchElement : public AstNode {
 public:
     virtual MimRegex generateMimIR(MimirCodeGen& code_gen) const = 0;
 
+    // Emits the instructions of the element, continuing at next, and returns the first one.
+    virtual uint32_t generatePike(PikeProgram& program, uint32_t next) const = 0;
+
+    [[nodiscard]] virtual LiteralInfo extractLiterals() const = 0;
+
+    [[nodiscard]] virtual LengthBounds lengthBounds() const = 0;
+
+    [[nodiscard]] virtual EdgeBytes edgeBytes() const = 0;
+
+    // Appends the pieces of the element to the shape and returns true, or returns false if it has none.
+    virtual bool appendShape(std::vector<ShapePiece>& shape) const = 0;
+
+    // The element with its parts optimized, see Expression::optimize.
+    [[nodiscard]] virtual const MatchElement* optimize(AstArena&) const {
+        return this;
+    }
+
+    // The bytes the element matches, if it matches a single byte.
+    [[nodiscard]] virtual std::optional<ByteSet> singleByte() const {
+        return std::nullopt;
+    }
+
+    // The group the element consists of, if it is one.
+    [[nodiscard]] virtual const Group* asGroup() const {
+        return nullptr;
+    }
+
 };
 
 class Match final : public AstNode {
 
     const MatchElement* const element;
-    const Quantifier* const quantifier;
+    const std::optional<Quantifier> quantifier;
 
 public:
-    explicit Match(const MatchElement* el): element(el), quantifier(nullptr) {}
-
-    explicit Match(const MatchElement* el, const Quantifier quantifier): element(el), quantifier(new Quantifier(quantifier)) {}
+    explicit Match(const MatchElement* el, const std::optional<Quantifier> quantifier = std::nullopt):
+        element(el), quantifier(quantifier) {}
 
     MimRegex generateMimIR(MimirCodeGen& code_gen) const;
 
+    uint32_t generatePike(PikeProgram& program, uint32_t next) const;
+
+    [[nodiscard]] LiteralInfo extractLiterals() const;
+
+    [[nodiscard]] LengthBounds lengthBounds() const;
+
+    [[nodiscard]] EdgeBytes edgeBytes() const;
+
+    bool appendShape(std::vector<ShapePiece>& shape) const;
+
+    [[nodiscard]] Match* optimize(AstArena& arena) const;
+
+    // The match or the empty text, e.g. "a*" for "a+".
+    [[nodiscard]] Match* optional(AstArena& arena) const;
+
+    // The single match that is the same as this one followed by the next, e.g. "a+" for "a*" and "a+", if any.
+    [[nodiscard]] static Match* merge(AstArena& arena, const Match& match, const Match& next);
+
+    // The bytes the match matches, if it is a single byte without a quantifier.
+    [[nodiscard]] std::optional<ByteSet> singleByte() const;
+
+    // The regex of the group the match consists of, if it is a group without a quantifier.
+    [[nodiscard]] const Expression* plainGroup() const;
+
+    void appendKey(std::string& key) const;
+
 };
 
 class Conjunction final : public AstNode {
-    std::vector<Match*> children;
+    std::pmr::vector<Match*> children;
 public:
-    explicit Conjunction(Match* el) {
+    using allocator_type = AstArena::allocator_type;
+
+    explicit Conjunction(Match* el, const allocator_type& allocator = {}): children(allocator) {
         children.push_back(el);
     }
 
-    explicit Conjunction() = default;
+    explicit Conjunction(const allocator_type& allocator = {}): children(allocator) {}
 
     void add_child(Match* el) {
         children.push_back(el);
     }
 
     MimRegex generateMimIR(MimirCodeGen& code_gen) const;
+
+    uint32_t generatePike(PikeProgram& program, uint32_t next) const;
+
+    [[nodiscard]] LiteralInfo extractLiterals() const;
+
+    [[nodiscard]] LengthBounds lengthBounds() const;
+
+    [[nodiscard]] EdgeBytes edgeBytes() const;
+
+    bool appendShape(std::vector<ShapePiece>& shape) const;
+
+    [[nodiscard]] const std::pmr::vector<Match*>& matches() const {
+        return children;
+    }
+
+    [[nodiscard]] Conjunction* optimize(AstArena& arena) const;
+
+    // Appends the optimized match, splicing in a group without a quantifier and alternatives, e.g. "(bc)" in
+    // "a(bc)d", and merging it with the match before, e.g. "a*" and "a+".
+    void appendOptimized(AstArena& arena, Match* match);
+
+    [[nodiscard]] std::optional<ByteSet> singleByte() const;
+
+    [[nodiscard]] const Expression* plainGroup() const;
+
+    void appendKey(std::string& key) const;
+
 };
 
 class Expression final : public AstNode {
-    std::vector<Conjunction*> children;
+    std::pmr::vector<Conjunction*> children;
 public:
-    explicit Expression(Conjunction* conj) {
+    using allocator_type = AstArena::allocator_type;
+
+    explicit Expression(Conjunction* conj, const allocator_type& allocator = {}): children(allocator) {
         children.push_back(conj);
     }
 
-    explicit Expression() = default;
+    explicit Expression(const allocator_type& allocator = {}): children(allocator) {}
 
     void add_child(Conjunction* conj) {
         children.push_back(conj);
@@ -66,6 +163,45 @@ public:
 
     MimRegex generateMimIR(MimirCodeGen& code_gen) const;
 
+    uint32_t generatePike(PikeProgram& program, uint32_t next) const;
+
+    // Builds the program the Pike VM matches the whole regex with.
+    [[nodiscard]] PikeProgram generatePikeProgram() const;
+
+    // Generates everything MimirCodeGen::make_matcher compiles the regex from.
+    [[nodiscard]] MatcherSource generateMatcherSource(MimirCodeGen& code_gen) const;
+
+    // What the regex tells about the literals in the lines it matches, see LiteralInfo.
+    [[nodiscard]] LiteralInfo extractLiterals() const;
+
+    // The shortest and the longest line the regex matches.
+    [[nodiscard]] LengthBounds lengthBounds() const;
+
+    // The bytes the lines the regex matches can start and end with.
+    [[nodiscard]] EdgeBytes edgeBytes() const;
+
+    bool appendShape(std::vector<ShapePiece>& shape) const;
+
+    // The regex as a sequence of single bytes, each possibly optional or repeated, if it has no alternatives
+    // and no quantified groups. See FastPath.
+    [[nodiscard]] std::optional<std::vector<ShapePiece>> shape() const;
+
+    [[nodiscard]] const std::pmr::vector<Conjunction*>& alternatives() const {
+        return children;
+    }
+
+    // A regex matching the same lines with a smaller AST, and thus less MimIR and smaller automata: groups are
+    // flattened, nested quantifiers combined, e.g. "(a*)*" into "a*", repeated pieces merged, e.g. "a*a*" into
+    // "a*", duplicate alternatives dropped, alternatives of single bytes folded into one set, e.g. "a|b|[cd]"
+    // into "[abcd]", and common prefixes and suffixes of alternatives factored out, e.g. "abc|abd" into "ab[cd]".
+    // As regexes only tell whether a line matches, the order of alternatives and whether groups capture do not
+    // matter. The optimized AST is made in the arena of this one, with which it shares the unchanged nodes.
+    [[nodiscard]] Expression* optimize(AstArena& arena) const;
+
+    // Appends a key that is the same for two regexes exactly if their ASTs have the same structure and sets.
+    void appendKey(std::string& key) const;
+
+
 };
 
 class Group final : public AstNode {
@@ -81,6 +217,34 @@ public:
         return expression->generateMimIR(code_gen);
     }
 
+    uint32_t generatePike(PikeProgram& program, const uint32_t next) const {
+        return expression->generatePike(program, next);
+    }
+
+    [[nodiscard]] LiteralInfo extractLiterals() const {
+        return expression->extractLiterals();
+    }
+
+    [[nodiscard]] LengthBounds lengthBounds() const {
+        return expression->lengthBounds();
+    }
+
+    [[nodiscard]] EdgeBytes edgeBytes() const {
+        return expression->edgeBytes();
+    }
+
+    bool appendShape(std::vector<ShapePiece>& shape) const {
+        return expression->appendShape(shape);
+    }
+
+    [[nodiscard]] const Expression* body() const {
+        return expression;
+    }
+
+    [[nodiscard]] Group* optimize(AstArena& arena) const {
+        return arena.make<Group>(is_noncapturing, expression->optimize(arena));
+    }
+
 };
 
 enum class CharacterClass {
@@ -99,6 +263,12 @@ enum class CharacterAltType {
     NegatedIncludingClosingBracket
 };
 
+// The regex matching a single byte of the set, as few ranges as possible in ascending order.
+MimRegex byteSetToRegex(MimirCodeGen& code_gen, const ByteSet& bytes);
+
+// The bytes a character class matches.
+ByteSet characterClassToByteSet(CharacterClass cls);
+
 class CharacterRange final : public AstNode {
     char lower_bound;
     char upper_bound;
@@ -107,23 +277,23 @@ public:
 
     explicit CharacterRange(const char c): lower_bound(c), upper_bound(c) {}
 
-    MimRegex generateMimIR(MimirCodeGen& code_gen) const {
-        const MimChar lower_bound_char = code_gen.char_lit(lower_bound);
-        const MimChar upper_bound_char = code_gen.char_lit(upper_bound);
-        return code_gen.regex_range(lower_bound_char, upper_bound_char);
+    void addTo(ByteSet& bytes) const {
+        bytes.insert_range(static_cast<unsigned char>(lower_bound), static_cast<unsigned char>(upper_bound));
     }
 };
 
 class CharacterSet final : public AstNode {
 
-    std::vector<CharacterRange*> ranges;
-    std::vector<CharacterClass> classes;
+    std::pmr::vector<CharacterRange*> ranges;
+    std::pmr::vector<CharacterClass> classes;
 public:
-    explicit CharacterSet(CharacterRange* range) {
+    using allocator_type = AstArena::allocator_type;
+
+    explicit CharacterSet(CharacterRange* range, const allocator_type& allocator = {}): ranges(allocator), classes(allocator) {
         ranges.push_back(range);
     }
 
-    explicit CharacterSet(const CharacterClass& cls) {
+    explicit CharacterSet(const CharacterClass& cls, const allocator_type& allocator = {}): ranges(allocator), classes(allocator) {
         classes.push_back(cls);
     }
 
@@ -135,19 +305,24 @@ public:
         classes.push_back(cls);
     }
 
-    MimRegex generateMimIR(MimirCodeGen& code_gen, bool negate, bool addClosingBracket) const;
+    [[nodiscard]] ByteSet toByteSet(bool negate, bool addClosingBracket) const;
 
 };
 
+// A bracket expression, e.g. "[^a-z\\d]". Its ranges, classes and closing bracket are merged into the set of bytes
+// it matches when it is parsed, and a negation is applied to that set, so that every later pass sees one set.
 class CharacterAlt final : public AstNode {
 
-    const CharacterAltType type;
-    const CharacterSet* const set;
+    const ByteSet bytes;
 
 public:
-    explicit CharacterAlt(const CharacterAltType type, const CharacterSet* set): type(type), set(set) {}
+    explicit CharacterAlt(CharacterAltType type, const CharacterSet* set);
 
-    MimRegex generateMimIR(MimirCodeGen& code_gen) const;
+    explicit CharacterAlt(const ByteSet& bytes): bytes(bytes) {}
+
+    [[nodiscard]] const ByteSet& toByteSet() const {
+        return bytes;
+    }
 
 };
 
@@ -158,6 +333,31 @@ public:
         return code_gen.regex_any();
     }
 
+    uint32_t generatePike(PikeProgram& program, const uint32_t next) const override {
+        return program.emit_bytes(ByteSet::all(), next);
+    }
+
+    [[nodiscard]] LiteralInfo extractLiterals() const override {
+        return LiteralInfo::any();
+    }
+
+    [[nodiscard]] LengthBounds lengthBounds() const override {
+        return LengthBounds::exactly(1);
+    }
+
+    [[nodiscard]] EdgeBytes edgeBytes() const override {
+        return EdgeBytes::of(ByteSet::all());
+    }
+
+    bool appendShape(std::vector<ShapePiece>& shape) const override {
+        shape.push_back(ShapePiece{ByteSet::all()});
+        return true;
+    }
+
+    [[nodiscard]] std::optional<ByteSet> singleByte() const override {
+        return ByteSet::all();
+    }
+
 };
 
 class LiteralMatchElement final : public MatchElement {
@@ -171,16 +371,78 @@ public:
         return code_gen.regex_lit(value);
     }
 
+    uint32_t generatePike(PikeProgram& program, const uint32_t next) const override {
+        ByteSet bytes;
+        bytes.insert(static_cast<unsigned char>(value));
+        return program.emit_bytes(bytes, next);
+    }
+
+    [[nodiscard]] LiteralInfo extractLiterals() const override {
+        ByteSet bytes;
+        bytes.insert(static_cast<unsigned char>(value));
+        return LiteralInfo::bytes(bytes);
+    }
+
+    [[nodiscard]] LengthBounds lengthBounds() const override {
+        return LengthBounds::exactly(1);
+    }
+
+    [[nodiscard]] EdgeBytes edgeBytes() const override {
+        ByteSet bytes;
+        bytes.insert(static_cast<unsigned char>(value));
+        return EdgeBytes::of(bytes);
+    }
+
+    bool appendShape(std::vector<ShapePiece>& shape) const override {
+        ByteSet bytes;
+        bytes.insert(static_cast<unsigned char>(value));
+        shape.push_back(ShapePiece{bytes});
+        return true;
+    }
+
+    [[nodiscard]] std::optional<ByteSet> singleByte() const override {
+        ByteSet bytes;
+        bytes.insert(static_cast<unsigned char>(value));
+        return bytes;
+    }
+
 };
 
 class CharacterClassMatchElement final : public MatchElement {
 
-    const CharacterClass char_class;
+    const ByteSet bytes;
 
 public:
-    explicit CharacterClassMatchElement(const CharacterClass char_class): char_class(char_class) {}
+    explicit CharacterClassMatchElement(const CharacterClass char_class): bytes(characterClassToByteSet(char_class)) {}
+
+    MimRegex generateMimIR(MimirCodeGen& code_gen) const override {
+        return byteSetToRegex(code_gen, bytes);
+    }
+
+    uint32_t generatePike(PikeProgram& program, const uint32_t next) const override {
+        return program.emit_bytes(bytes, next);
+    }
+
+    [[nodiscard]] LiteralInfo extractLiterals() const override {
+        return LiteralInfo::bytes(bytes);
+    }
 
-    MimRegex generateMimIR(MimirCodeGen& code_gen) const override;
+    [[nodiscard]] LengthBounds lengthBounds() const override {
+        return LengthBounds::exactly(1);
+    }
+
+    [[nodiscard]] EdgeBytes edgeBytes() const override {
+        return EdgeBytes::of(bytes);
+    }
+
+    bool appendShape(std::vector<ShapePiece>& shape) const override {
+        shape.push_back(ShapePiece{bytes});
+        return true;
+    }
+
+    [[nodiscard]] std::optional<ByteSet> singleByte() const override {
+        return bytes;
+    }
 
 };
 
@@ -192,7 +454,32 @@ public:
     explicit CharacterAltMatchElement(const CharacterAlt* character_alt): character_alt(character_alt) {}
 
     MimRegex generateMimIR(MimirCodeGen& code_gen) const override {
-        return character_alt->generateMimIR(code_gen);
+        return byteSetToRegex(code_gen, character_alt->toByteSet());
+    }
+
+    uint32_t generatePike(PikeProgram& program, const uint32_t next) const override {
+        return program.emit_bytes(character_alt->toByteSet(), next);
+    }
+
+    [[nodiscard]] LiteralInfo extractLiterals() const override {
+        return LiteralInfo::bytes(character_alt->toByteSet());
+    }
+
+    [[nodiscard]] LengthBounds lengthBounds() const override {
+        return LengthBounds::exactly(1);
+    }
+
+    [[nodiscard]] EdgeBytes edgeBytes() const override {
+        return EdgeBytes::of(character_alt->toByteSet());
+    }
+
+    bool appendShape(std::vector<ShapePiece>& shape) const override {
+        shape.push_back(ShapePiece{character_alt->toByteSet()});
+        return true;
+    }
+
+    [[nodiscard]] std::optional<ByteSet> singleByte() const override {
+        return character_alt->toByteSet();
     }
 
 };
@@ -208,4 +495,32 @@ public:
         return group->generateMimIR(code_gen);
     }
 
+    uint32_t generatePike(PikeProgram& program, const uint32_t next) const override {
+        return group->generatePike(program, next);
+    }
+
+    [[nodiscard]] LiteralInfo extractLiterals() const override {
+        return group->extractLiterals();
+    }
+
+    [[nodiscard]] LengthBounds lengthBounds() const override {
+        return group->lengthBounds();
+    }
+
+    [[nodiscard]] EdgeBytes edgeBytes() const override {
+        return group->edgeBytes();
+    }
+
+    bool appendShape(std::vector<ShapePiece>& shape) const override {
+        return group->appendShape(shape);
+    }
+
+    [[nodiscard]] const MatchElement* optimize(AstArena& arena) const override {
+        return arena.make<GroupMatchElement>(group->optimize(arena));
+    }
+
+    [[nodiscard]] const Group* asGroup() const override {
+        return group;
+    }
+
 };
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <memory_resource>
+#include <utility>
+
+// AstArena holds the nodes of the ASTs of a parse, see parse_regex, next to each other in a few blocks of memory.
+// Nodes are made with a bump of a pointer and never freed one by one; destroying the arena releases all of them
+// at once, without running their destructors. Nodes therefore keep their own data, e.g. the lists of their
+// children, in the arena as well, by taking its allocator, see allocator_type.
+class AstArena final {
+
+    // the first block, which holds the AST of most regexes, so that parsing them allocates no further memory
+    std::array<std::byte, 2048> initial_block;
+    std::pmr::monotonic_buffer_resource resource{initial_block.data(), initial_block.size()};
+
+    // the arena the parser on this thread makes its nodes in, see Scope
+    inline static thread_local AstArena* current_arena = nullptr;
+
+public:
+    // The allocator nodes with data of their own take as their last constructor argument.
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    // Makes the arena the current one on this thread while the scope lives.
+    class Scope final {
+
+        AstArena* const previous;
+
+    public:
+        explicit Scope(AstArena& arena) : previous(std::exchange(current_arena, &arena)) {}
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope() {
+            current_arena = previous;
+        }
+
+    };
+
+    AstArena() = default;
+
+    AstArena(const AstArena&) = delete;
+    AstArena& operator=(const AstArena&) = delete;
+
+    // Makes a node in the arena, passing the arena's allocator to nodes that take one.
+    template <typename Node, typename... Args>
+    [[nodiscard]] Node* make(Args&&... args) {
+        return allocator_type(&resource).new_object<Node>(std::forward<Args>(args)...);
+    }
+
+    // The arena the parser makes its nodes in. Only valid within a Scope.
+    [[nodiscard]] static AstArena& current() {
+        assert(current_arena != nullptr);
+        return *current_arena;
+    }
+
+};
+
+// Makes a node in the current arena, which is what the actions of the parser do.
+template <typename Node, typename... Args>
+[[nodiscard]] Node* make_node(Args&&... args) {
+    return AstArena::current().make<Node>(std::forward<Args>(args)...);
+}
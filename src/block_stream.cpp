@@ -0,0 +1,31 @@
+#include "block_stream.hpp"
+
+BlockStream::~BlockStream() {
+    filled.close();
+    if (producer.joinable()) {
+        producer.join();
+    }
+}
+
+void BlockStream::start(std::function<void(BlockStream&)> produce) {
+    producer = std::thread([this, produce = std::move(produce)] {
+        try {
+            produce(*this);
+        }
+        catch (...) {
+            producer_error = std::current_exception();
+        }
+        filled.close();
+    });
+}
+
+Block BlockStream::acquire() {
+
+    if (std::optional<Block> block = recycled.try_pop()) {
+        block->size = 0;
+        return std::move(*block);
+    }
+
+    return Block{std::make_unique<char[]>(block_capacity), 0};
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+
+#include "bounded_queue.hpp"
+#include "consumer.hpp"
+#include "line_assembler.hpp"
+
+// A piece of input produced by a streaming source, e.g. the output of a decompressor.
+struct Block {
+    std::unique_ptr<char[]> data;
+    size_t size = 0;
+};
+
+// BlockStream carries input from a producer thread to the thread matching its lines.
+//
+// Filled blocks travel through a bounded queue, so the producer runs at most `depth` blocks ahead of the
+// consumer and both work at the same time. Consumed blocks travel back to the producer to be refilled,
+// so no memory is allocated once the pipeline is running.
+class BlockStream final {
+
+public:
+    static constexpr size_t block_capacity = 1 << 20;
+    static constexpr size_t depth = 4;
+
+private:
+    BoundedQueue<Block> filled;
+    // at most depth + 2 blocks exist at any time, thus pushing back a consumed block never blocks
+    BoundedQueue<Block> recycled;
+
+    std::thread producer;
+    // set by the producer before it closes the stream
+    std::exception_ptr producer_error;
+
+public:
+    BlockStream() : filled(depth), recycled(depth + 2) {}
+
+    BlockStream(const BlockStream&) = delete;
+    BlockStream& operator=(const BlockStream&) = delete;
+
+    // Stops the producer, if it is still running, and waits for it.
+    ~BlockStream();
+
+    // Runs produce(*this) on a new thread. The stream is closed when produce returns or throws.
+    void start(std::function<void(BlockStream&)> produce);
+
+    /// Producer side
+
+    // Returns an empty block with block_capacity bytes of storage.
+    Block acquire();
+
+    // Hands a filled block to the consumer. Returns false if the consumer has stopped reading,
+    // in which case the producer should return.
+    bool publish(Block block) {
+        return filled.push(std::move(block));
+    }
+
+    /// Consumer side
+
+    // Calls consumer(data, size) for every block of the stream, in order. The block may be modified in place.
+    // Rethrows the exception the producer failed with, after all blocks produced before the failure.
+    // If the consumer returns false, the stream is closed and the producer stops at its next block.
+    template<typename BlockConsumer>
+    void for_each_block(BlockConsumer&& consumer);
+
+    // Calls consumer(line, line_length) for every line of the stream, in order, with the same guarantees
+    // as InputFile::for_each_line. Lines spanning several blocks are assembled in a separate buffer.
+    // Rethrows the exception the producer failed with, after all complete lines produced before the failure.
+    // The stream is closed early if the consumer returns false.
+    template<typename Consumer>
+    void for_each_line(Consumer&& consumer) {
+        LineAssembler lines;
+        bool more = true;
+        for_each_block([&](char* data, const size_t size) { return more = lines.feed(data, size, consumer); });
+        if (more) {
+            lines.finish(consumer);
+        }
+    }
+
+};
+
+template<typename BlockConsumer>
+void BlockStream::for_each_block(BlockConsumer&& consumer) {
+
+    try {
+        while (std::optional<Block> block = filled.pop()) {
+            if (!consume(consumer, block->data.get(), block->size)) {
+                filled.close();
+                return;
+            }
+            recycled.push(std::move(*block));
+        }
+    }
+    catch (...) {
+        // let the producer run into a closed stream instead of blocking forever
+        filled.close();
+        throw;
+    }
+
+    if (producer_error) {
+        std::rethrow_exception(producer_error);
+    }
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+// BoundedQueue is a blocking first-in first-out queue holding at most `capacity` elements.
+// It connects a producer thread with a consumer thread: push() blocks while the queue is full,
+// pop() blocks while it is empty. After close(), pop() drains the remaining elements and then returns nullopt.
+template<typename T>
+class BoundedQueue final {
+
+    const size_t capacity;
+
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::deque<T> elements;
+    bool closed = false;
+
+public:
+    explicit BoundedQueue(const size_t capacity) : capacity(capacity) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Returns false, and drops the element, if the queue has been closed.
+    bool push(T element) {
+
+        {
+            std::unique_lock lock(mutex);
+            not_full.wait(lock, [this] { return closed || elements.size() < capacity; });
+
+            if (closed) {
+                return false;
+            }
+
+            elements.push_back(std::move(element));
+        }
+
+        not_empty.notify_one();
+        return true;
+
+    }
+
+    // Returns nullopt instead of blocking if the queue is empty.
+    std::optional<T> try_pop() {
+
+        std::optional<T> element;
+
+        {
+            std::lock_guard lock(mutex);
+
+            if (elements.empty()) {
+                return std::nullopt;
+            }
+
+            element = std::move(elements.front());
+            elements.pop_front();
+        }
+
+        not_full.notify_one();
+        return element;
+
+    }
+
+    std::optional<T> pop() {
+
+        std::optional<T> element;
+
+        {
+            std::unique_lock lock(mutex);
+            not_empty.wait(lock, [this] { return closed || !elements.empty(); });
+
+            if (elements.empty()) {
+                return std::nullopt;
+            }
+
+            element = std::move(elements.front());
+            elements.pop_front();
+        }
+
+        not_full.notify_one();
+        return element;
+
+    }
+
+    void close() {
+
+        {
+            std::lock_guard lock(mutex);
+            closed = true;
+        }
+
+        not_full.notify_all();
+        not_empty.notify_all();
+
+    }
+
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// ByteSet is a set of byte values, i.e. the characters a single position of the input may hold,
+// e.g. for a literal, a range, a character class or the dot.
+class ByteSet final {
+
+    std::array<uint64_t, 4> words{};
+
+public:
+    // The set of every byte, which the dot matches.
+    [[nodiscard]] static ByteSet all() {
+        ByteSet set;
+        set.words.fill(~uint64_t{0});
+        return set;
+    }
+
+    void insert(const unsigned char c) {
+        words[c >> 6] |= uint64_t{1} << (c & 63);
+    }
+
+    // Inserts every byte from lower to upper, both inclusive. Nothing if lower is greater than upper.
+    void insert_range(const unsigned char lower, const unsigned char upper) {
+        for (unsigned c = lower; c <= upper; c++) {
+            insert(static_cast<unsigned char>(c));
+        }
+    }
+
+    [[nodiscard]] bool contains(const unsigned char c) const {
+        return (words[c >> 6] >> (c & 63)) & 1;
+    }
+
+    [[nodiscard]] size_t count() const {
+        return std::popcount(words[0]) + std::popcount(words[1]) + std::popcount(words[2]) + std::popcount(words[3]);
+    }
+
+    [[nodiscard]] bool empty() const {
+        return (words[0] | words[1] | words[2] | words[3]) == 0;
+    }
+
+    // Calls visit(lower, upper) for each maximal range of consecutive bytes in the set, in ascending order.
+    template <typename Visitor>
+    void for_each_range(Visitor&& visit) const {
+
+        unsigned c = 0;
+
+        while (c < 256) {
+
+            // the next byte in the set starts a range
+            const uint64_t rest = words[c >> 6] >> (c & 63);
+            if (rest == 0) {
+                c = (c | 63) + 1;
+                continue;
+            }
+            c += std::countr_zero(rest);
+            const unsigned lower = c;
+
+            // which ends before the next byte not in the set, possibly in a later word
+            while (c < 256) {
+                const unsigned shift = c & 63;
+                const unsigned ones = std::countr_one(words[c >> 6] >> shift);
+                c += ones;
+                if (ones < 64 - shift) {
+                    break;
+                }
+            }
+
+            visit(static_cast<unsigned char>(lower), static_cast<unsigned char>(c - 1));
+
+        }
+
+    }
+
+    // The bytes not in this set.
+    [[nodiscard]] ByteSet complement() const {
+        ByteSet set;
+        for (size_t i = 0; i < words.size(); i++) {
+            set.words[i] = ~words[i];
+        }
+        return set;
+    }
+
+    ByteSet& operator|=(const ByteSet& other) {
+        for (size_t i = 0; i < words.size(); i++) {
+            words[i] |= other.words[i];
+        }
+        return *this;
+    }
+
+    bool operator==(const ByteSet& other) const = default;
+
+};
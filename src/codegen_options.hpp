@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+// CodeGenOptions control how the LLVM IR generated for a regex is turned into machine code.
+// Higher optimization and a specific CPU cost compile time, but speed up matching, which pays off for large inputs.
+struct CodeGenOptions {
+
+    // Optimization level from 0, fastest to compile, to 3, like clang's -O<n>.
+    int opt_level = 2;
+
+    // CPU to generate code for, like clang's -march, e.g. "native" or "x86-64-v3".
+    // Empty means the default of the backend: the host CPU for the JIT, a generic CPU for clang.
+    std::string march;
+
+    // CPU to tune the code for without relying on its features, like clang's -mtune.
+    std::string mtune;
+
+    // Hand the IR to clang as bitcode rather than as text. Needs LLVM, i.e. REGEXFE_HAVE_LLVM_JIT.
+    bool bitcode = false;
+
+    // Throws std::runtime_error if the options are invalid, or if they need LLVM and this build lacks it.
+    void validate() const {
+
+        if (opt_level < 0 || opt_level > 3) {
+            throw std::runtime_error("0: error: Invalid optimization level " + std::to_string(opt_level) + ".");
+        }
+
+#ifndef REGEXFE_HAVE_LLVM_JIT
+        if (bitcode) {
+            throw std::runtime_error("0: error: Emitting bitcode needs a build with LLVM.");
+        }
+#endif
+
+    }
+
+    // The options as arguments to clang. Also identifies the options in the keys of cached matchers.
+    [[nodiscard]] std::string clang_flags() const {
+
+        std::string flags = "-O" + std::to_string(opt_level);
+
+        if (!march.empty()) {
+            flags += " -march=" + march;
+        }
+
+        if (!mtune.empty()) {
+            flags += " -mtune=" + mtune;
+        }
+
+        return flags;
+
+    }
+
+};
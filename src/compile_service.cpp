@@ -0,0 +1,122 @@
+#include "compile_service.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+
+#include "regexfe.hpp"
+
+CompileService::CompileService(const size_t worker_count, std::function<void(MimirCodeGen&)> configure)
+    : configure(std::move(configure)), pool(worker_count) {}
+
+std::unique_ptr<MimirCodeGen> CompileService::borrow() {
+
+    {
+        std::lock_guard lock(mutex);
+        if (!idle.empty()) {
+            std::unique_ptr<MimirCodeGen> code_gen = std::move(idle.back());
+            idle.pop_back();
+            return code_gen;
+        }
+    }
+
+    // at most one per worker, as each worker gives back its instance before borrowing again
+    auto code_gen = std::make_unique<MimirCodeGen>();
+
+    if (configure) {
+        configure(*code_gen);
+    }
+
+    return code_gen;
+
+}
+
+void CompileService::give_back(std::unique_ptr<MimirCodeGen> code_gen) {
+    std::lock_guard lock(mutex);
+    idle.push_back(std::move(code_gen));
+}
+
+void CompileService::compile_batch(const std::vector<std::string>& patterns, const size_t begin, const size_t end,
+                                   std::vector<std::optional<Matcher>>& matchers) {
+
+    std::vector<std::shared_ptr<const Expression>> expressions;
+
+    for (size_t i = begin; i < end; i++) {
+        expressions.push_back(parse_regex(patterns[i]));
+    }
+
+    // an instance whose compilation failed may be left in an unknown state, so it is not given back then
+    std::unique_ptr<MimirCodeGen> code_gen = borrow();
+
+    std::vector<MatcherSource> sources;
+    sources.reserve(expressions.size());
+
+    for (const std::shared_ptr<const Expression>& expression : expressions) {
+        sources.push_back(expression->generateMatcherSource(*code_gen));
+    }
+
+    std::vector<Matcher> compiled = code_gen->make_matchers(sources);
+    give_back(std::move(code_gen));
+
+    for (size_t i = begin; i < end; i++) {
+        matchers[i].emplace(std::move(compiled[i - begin]));
+    }
+
+}
+
+std::vector<Matcher> CompileService::compile(const std::vector<std::string>& patterns) {
+
+    std::vector<std::optional<Matcher>> matchers(patterns.size());
+
+    // contiguous batches of almost equal size, one per worker
+    const size_t batches = std::min(patterns.size(), pool.size());
+
+    std::mutex batch_mutex;
+    std::condition_variable done;
+    size_t remaining = batches;
+    std::exception_ptr first_exception;
+
+    for (size_t batch = 0; batch < batches; batch++) {
+        const size_t begin = patterns.size() * batch / batches;
+        const size_t end = patterns.size() * (batch + 1) / batches;
+
+        pool.submit([&, begin, end] {
+            std::exception_ptr exception;
+
+            try {
+                compile_batch(patterns, begin, end, matchers);
+            }
+            catch (...) {
+                exception = std::current_exception();
+            }
+
+            // notifies while holding the lock, as the waiting thread destroys everything once it sees the last task finish
+            std::lock_guard lock(batch_mutex);
+            if (exception && !first_exception) {
+                first_exception = exception;
+            }
+            if (--remaining == 0) {
+                done.notify_one();
+            }
+        });
+    }
+
+    {
+        std::unique_lock lock(batch_mutex);
+        done.wait(lock, [&] { return remaining == 0; });
+    }
+
+    if (first_exception) {
+        std::rethrow_exception(first_exception);
+    }
+
+    std::vector<Matcher> result;
+    result.reserve(matchers.size());
+
+    for (std::optional<Matcher>& matcher : matchers) {
+        result.push_back(std::move(*matcher));
+    }
+
+    return result;
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "matcher.hpp"
+#include "mimir_codegen.hpp"
+#include "thread_pool.hpp"
+
+// CompileService compiles many regexes in parallel on a pool of worker threads.
+//
+// The regexes are split into one batch per worker, and every batch is compiled into a single module,
+// so that the fixed cost of a compilation is paid once per worker rather than once per regex.
+// A MimirCodeGen must not be used by several threads at once, thus the service keeps one per worker.
+// Every batch borrows an idle one and returns it afterwards, so a regex compiled before is not compiled again.
+// The matchers own their code and stay valid after the service is destroyed.
+class CompileService final {
+
+    // called on every MimirCodeGen the service creates
+    std::function<void(MimirCodeGen&)> configure;
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<MimirCodeGen>> idle;
+
+    // declared last, so that the workers are stopped before anything they use is destroyed
+    ThreadPool pool;
+
+    std::unique_ptr<MimirCodeGen> borrow();
+
+    void give_back(std::unique_ptr<MimirCodeGen> code_gen);
+
+    // Compiles the patterns in [begin, end) and stores their matchers at the same indices.
+    void compile_batch(const std::vector<std::string>& patterns, size_t begin, size_t end,
+                       std::vector<std::optional<Matcher>>& matchers);
+
+public:
+    // Creates a service with the given number of workers, 0 means one worker per hardware thread.
+    // configure is called on every MimirCodeGen the service creates, e.g. to set its backend and cache.
+    explicit CompileService(size_t worker_count, std::function<void(MimirCodeGen&)> configure = {});
+
+    CompileService(const CompileService&) = delete;
+    CompileService& operator=(const CompileService&) = delete;
+
+    // Compiles the patterns in parallel and returns their matchers in the same order.
+    // May be called from several threads at once, but not from a task of the service's own pool.
+    // Rethrows the first error, i.e. a LexerError or ParserError for an invalid pattern,
+    // or a std::runtime_error if compiling fails.
+    [[nodiscard]] std::vector<Matcher> compile(const std::vector<std::string>& patterns);
+
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+// Calls a line or block consumer and tells whether the iteration should go on.
+// Consumers either return nothing, or return false to stop the iteration early, e.g. once enough lines are found.
+template<typename Consumer, typename... Args>
+bool consume(Consumer& consumer, Args&&... args) {
+    if constexpr (std::is_same_v<std::invoke_result_t<Consumer&, Args...>, bool>) {
+        return consumer(std::forward<Args>(args)...);
+    }
+    else {
+        consumer(std::forward<Args>(args)...);
+        return true;
+    }
+}
@@ -0,0 +1,175 @@
+#include "decompress.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <string>
+
+#include "input.hpp"
+
+#ifdef REGEXFE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef REGEXFE_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+Compression detect_compression(const std::string_view input) {
+
+    const auto starts_with = [&](std::initializer_list<uint8_t> magic) {
+        return input.size() >= magic.size()
+            && std::equal(magic.begin(), magic.end(), input.begin(), [](const uint8_t m, const char c) {
+                   return m == static_cast<uint8_t>(c);
+               });
+    };
+
+    if (starts_with({0x1f, 0x8b})) {
+        return Compression::Gzip;
+    }
+
+    if (starts_with({0x28, 0xb5, 0x2f, 0xfd})) {
+        return Compression::Zstd;
+    }
+
+    return Compression::None;
+
+}
+
+#ifdef REGEXFE_HAVE_ZLIB
+
+static void decompress_gzip(const std::string_view input, BlockStream& stream) {
+
+    z_stream z{};
+
+    // 32: detect the gzip or zlib header automatically
+    if (inflateInit2(&z, 15 + 32) != Z_OK) {
+        throw InputError("0: error: could not initialize gzip decompression.");
+    }
+
+    const std::unique_ptr<z_stream, int (*)(z_streamp)> guard(&z, inflateEnd);
+
+    const char* next_input = input.data();
+    size_t remaining_input = input.size();
+
+    Block block = stream.acquire();
+    bool done = false;
+
+    while (!done) {
+
+        // avail_in is only 32 bits wide
+        if (z.avail_in == 0 && remaining_input > 0) {
+            z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(next_input));
+            z.avail_in = static_cast<uInt>(std::min<size_t>(remaining_input, UINT_MAX));
+            next_input += z.avail_in;
+            remaining_input -= z.avail_in;
+        }
+
+        z.next_out = reinterpret_cast<Bytef*>(block.data.get() + block.size);
+        z.avail_out = static_cast<uInt>(BlockStream::block_capacity - block.size);
+
+        const int result = inflate(&z, Z_NO_FLUSH);
+
+        block.size = BlockStream::block_capacity - z.avail_out;
+
+        if (result == Z_STREAM_END) {
+            // gzip files may consist of several concatenated members
+            if (z.avail_in > 0 || remaining_input > 0) {
+                inflateReset(&z);
+            }
+            else {
+                done = true;
+            }
+        }
+        else if (result == Z_BUF_ERROR && z.avail_in == 0 && remaining_input == 0) {
+            throw InputError("0: error: gzip input is truncated.");
+        }
+        else if (result != Z_OK && result != Z_BUF_ERROR) {
+            throw InputError("0: error: gzip input is corrupt.");
+        }
+
+        if (block.size == BlockStream::block_capacity || (done && block.size > 0)) {
+            if (!stream.publish(std::move(block))) {
+                return;
+            }
+            block = stream.acquire();
+        }
+    }
+
+}
+
+#endif
+
+#ifdef REGEXFE_HAVE_ZSTD
+
+static void decompress_zstd(const std::string_view input, BlockStream& stream) {
+
+    const std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+
+    if (context == nullptr) {
+        throw InputError("0: error: could not initialize zstd decompression.");
+    }
+
+    ZSTD_inBuffer in{input.data(), input.size(), 0};
+
+    // 0 once the last frame is complete and flushed
+    size_t last_result;
+    bool output_full;
+
+    do {
+
+        Block block = stream.acquire();
+        ZSTD_outBuffer out{block.data.get(), BlockStream::block_capacity, 0};
+
+        last_result = ZSTD_decompressStream(context.get(), &out, &in);
+
+        if (ZSTD_isError(last_result)) {
+            throw InputError(std::string("0: error: zstd input is corrupt: ") + ZSTD_getErrorName(last_result) + ".");
+        }
+
+        block.size = out.pos;
+        // a full output buffer may leave decompressed data behind in the context
+        output_full = out.pos == out.size;
+
+        if (block.size > 0 && !stream.publish(std::move(block))) {
+            return;
+        }
+
+    } while (in.pos < in.size || output_full);
+
+    if (last_result != 0) {
+        throw InputError("0: error: zstd input is truncated.");
+    }
+
+}
+
+#endif
+
+void decompress(const Compression compression,
+                [[maybe_unused]] const std::string_view input,
+                [[maybe_unused]] BlockStream& stream) {
+
+    switch (compression) {
+
+        case Compression::Gzip:
+#ifdef REGEXFE_HAVE_ZLIB
+            decompress_gzip(input, stream);
+            return;
+#else
+            throw InputError("0: error: gzip input is not supported, regexfe was built without zlib.");
+#endif
+
+        case Compression::Zstd:
+#ifdef REGEXFE_HAVE_ZSTD
+            decompress_zstd(input, stream);
+            return;
+#else
+            throw InputError("0: error: zstd input is not supported, regexfe was built without libzstd.");
+#endif
+
+        default:
+            assert(false);
+    }
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string_view>
+
+#include "block_stream.hpp"
+
+enum class Compression {
+    None,
+    Gzip,
+    Zstd
+};
+
+// Detects the compression format of the input from its magic bytes.
+Compression detect_compression(std::string_view input);
+
+// Decompresses the input block by block into the stream, stops early if the consumer stops reading.
+// Throws InputError if the input is corrupt or support for the format was not compiled in.
+void decompress(Compression compression, std::string_view input, BlockStream& stream);
@@ -0,0 +1,158 @@
+#include "dfa_table.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+struct ThreadsHash {
+    size_t operator()(const std::vector<uint32_t>& threads) const {
+        size_t hash = threads.size();
+        for (const uint32_t thread : threads) {
+            hash ^= thread + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        }
+        return hash;
+    }
+};
+
+// Computes the threads of DFA states: the Byte and Match instructions reached from some instructions without
+// consuming input, sorted.
+class Closure final {
+
+    const PikeProgram& program;
+    std::vector<uint32_t> stack;
+    std::vector<uint32_t> seen;
+    uint32_t generation = 0;
+
+public:
+    std::vector<uint32_t> threads;
+
+    explicit Closure(const PikeProgram& program) : program(program), seen(program.size(), 0) {}
+
+    void begin() {
+        threads.clear();
+        generation++;
+    }
+
+    void follow(const uint32_t instruction) {
+
+        stack.push_back(instruction);
+
+        while (!stack.empty()) {
+            const uint32_t index = stack.back();
+            stack.pop_back();
+
+            if (seen[index] == generation) {
+                continue;
+            }
+            seen[index] = generation;
+
+            if (const PikeProgram::Instruction& split = program.instruction(index);
+                split.opcode == PikeProgram::Opcode::Split) {
+                stack.push_back(split.alternative);
+                stack.push_back(split.next);
+            }
+            else {
+                threads.push_back(index);
+            }
+        }
+
+    }
+
+    const std::vector<uint32_t>& end() {
+        std::sort(threads.begin(), threads.end());
+        return threads;
+    }
+
+};
+
+}
+
+DfaTable::DfaTable(const PikeProgram& program, const size_t max_transitions) {
+
+    classes = program.byte_classes(byte_classes);
+
+    std::vector<uint8_t> representatives(classes);
+    for (unsigned byte = 256; byte-- > 0;) {
+        representatives[byte_classes[byte]] = static_cast<uint8_t>(byte);
+    }
+
+    // the states in the order they are found, and their transitions to those indices
+    std::vector<std::vector<uint32_t>> found;
+    std::unordered_map<std::vector<uint32_t>, uint32_t, ThreadsHash> index;
+    std::vector<uint32_t> table;
+
+    const auto add_state = [&](const std::vector<uint32_t>& threads) {
+        if (const auto existing = index.find(threads); existing != index.end()) {
+            return existing->second;
+        }
+        if ((found.size() + 1) * classes > max_transitions) {
+            throw std::runtime_error("0: error: The automaton of the regex is too large to compile.");
+        }
+        const auto state = static_cast<uint32_t>(found.size());
+        found.push_back(threads);
+        index.emplace(threads, state);
+        return state;
+    };
+
+    Closure closure(program);
+    closure.begin();
+    closure.follow(program.entry());
+    const uint32_t found_start = add_state(closure.end());
+
+    // every thread of the state that consumes a byte of the class continues in the next state
+    for (uint32_t state = 0; state < found.size(); state++) {
+        for (size_t byte_class = 0; byte_class < classes; byte_class++) {
+            closure.begin();
+            for (const uint32_t thread : found[state]) {
+                if (const PikeProgram::Instruction& instruction = program.instruction(thread);
+                    instruction.opcode == PikeProgram::Opcode::Byte &&
+                    instruction.bytes.contains(representatives[byte_class])) {
+                    closure.follow(instruction.next);
+                }
+            }
+            table.push_back(closure.threads.empty() ? dead : add_state(closure.end()));
+        }
+    }
+
+    // renumbers the states, the accepting ones first, i.e. those with the Match instruction, which is the first one
+    std::vector<uint32_t> renumbered(found.size());
+    for (uint32_t state = 0; state < found.size(); state++) {
+        if (found[state].front() == PikeProgram::match()) {
+            renumbered[state] = accepting++;
+        }
+    }
+    uint32_t rejecting = accepting;
+    for (uint32_t state = 0; state < found.size(); state++) {
+        if (found[state].front() != PikeProgram::match()) {
+            renumbered[state] = rejecting++;
+        }
+    }
+
+    transitions.resize(table.size());
+    for (uint32_t state = 0; state < found.size(); state++) {
+        for (size_t byte_class = 0; byte_class < classes; byte_class++) {
+            const uint32_t next = table[state * classes + byte_class];
+            transitions[renumbered[state] * classes + byte_class] = next == dead ? dead : renumbered[next];
+        }
+    }
+    start = renumbered[found_start];
+
+}
+
+bool DfaTable::matches(const char* begin, const size_t length) const {
+
+    uint32_t state = start;
+
+    for (size_t i = 0; i < length; i++) {
+        state = transitions[state * classes + byte_classes[static_cast<unsigned char>(begin[i])]];
+        if (state == dead) {
+            return false;
+        }
+    }
+
+    return state < accepting;
+
+}
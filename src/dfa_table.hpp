@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "matcher.hpp"
+#include "pike_vm.hpp"
+
+// DfaTable is the complete DFA of a PikeProgram, built ahead of time by the subset construction. MimirCodeGen
+// generates the span functions of compiled matchers from it: unlike the automata of MimIR's regex plugin, which
+// consume input until they get stuck, e.g. at a NUL byte, the DFA consumes exactly the bytes of the span.
+// The span may thus be part of a larger buffer and contain NUL bytes, and it matches exactly like it does on the
+// interpreters, which run the same program.
+//
+// As in the LazyDfa, bytes that no instruction tells apart share a column of the table. The accepting states come
+// first, so a walk ends in an accepting state if the state is below accepting_states().
+class DfaTable final : public MatchEngine {
+
+public:
+    // the transition to the state without threads, which never matches
+    static constexpr uint32_t dead = std::numeric_limits<uint32_t>::max();
+
+    // The largest table built unless given otherwise, in transitions.
+    static constexpr size_t default_max_transitions = size_t{1} << 18;
+
+private:
+    std::array<uint8_t, 256> byte_classes{};
+    size_t classes = 0;
+    // one row per state, one column per byte class
+    std::vector<uint32_t> transitions;
+    uint32_t start = 0;
+    uint32_t accepting = 0;
+
+public:
+    // Builds the DFA of the program. Throws std::runtime_error if its table would have more than max_transitions
+    // transitions, as the DFA of a few regexes is exponentially larger than the regex, e.g. every "(a|b)" appended
+    // to "(a|b)*a" doubles the states.
+    explicit DfaTable(const PikeProgram& program, size_t max_transitions = default_max_transitions);
+
+    [[nodiscard]] size_t states() const {
+        return transitions.size() / classes;
+    }
+
+    [[nodiscard]] uint32_t accepting_states() const {
+        return accepting;
+    }
+
+    [[nodiscard]] uint32_t start_state() const {
+        return start;
+    }
+
+    // The state the DFA moves to from the given one on the byte, or dead.
+    [[nodiscard]] uint32_t next(const uint32_t state, const uint8_t byte) const {
+        return transitions[state * classes + byte_classes[byte]];
+    }
+
+    // Whether the whole span matches, walking the table like the generated span function walks the states.
+    [[nodiscard]] bool matches(const char* begin, size_t length) const override;
+
+};
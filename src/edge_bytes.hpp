@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+
+#include "byte_set.hpp"
+
+// EdgeBytes are the bytes the texts a piece of the regex matches can start and end with, i.e. its FIRST and
+// LAST sets, and whether it matches the empty text. They are computed bottom-up over the AST, see
+// Expression::edgeBytes. As regexes match whole lines, a line whose first or last byte is not among them
+// cannot match, which takes two lookups to find out.
+struct EdgeBytes {
+
+    ByteSet first;
+    ByteSet last;
+    bool nullable = true;
+
+    // A piece matching a single byte of the set.
+    [[nodiscard]] static EdgeBytes of(const ByteSet& bytes) {
+        return EdgeBytes{bytes, bytes, false};
+    }
+
+    // The edges of this piece followed by the other. Where a piece may be empty, the other one's edge shows.
+    [[nodiscard]] EdgeBytes then(const EdgeBytes& other) const {
+
+        EdgeBytes edges{first, other.last, nullable && other.nullable};
+
+        if (nullable) {
+            edges.first |= other.first;
+        }
+        if (other.nullable) {
+            edges.last |= last;
+        }
+
+        return edges;
+
+    }
+
+    // The edges of either this piece or the other.
+    [[nodiscard]] EdgeBytes either(const EdgeBytes& other) const {
+
+        EdgeBytes edges = *this;
+        edges.first |= other.first;
+        edges.last |= other.last;
+        edges.nullable = nullable || other.nullable;
+
+        return edges;
+
+    }
+
+    // The edges of the piece repeated at least the given number of times, and arbitrarily often.
+    [[nodiscard]] EdgeBytes repeated(const size_t at_least) const {
+        return EdgeBytes{first, last, nullable || at_least == 0};
+    }
+
+    // The edges of the piece or of the empty text.
+    [[nodiscard]] EdgeBytes optional() const {
+        return EdgeBytes{first, last, true};
+    }
+
+    // Whether a text with these first and last bytes may match.
+    [[nodiscard]] bool accepts(const char* begin, const size_t length) const {
+
+        if (length == 0) {
+            return nullable;
+        }
+
+        return first.contains(static_cast<unsigned char>(begin[0])) &&
+               last.contains(static_cast<unsigned char>(begin[length - 1]));
+
+    }
+
+    // Whether some texts are rejected.
+    [[nodiscard]] bool restrictive() const {
+        return !nullable || first != ByteSet::all() || last != ByteSet::all();
+    }
+
+};
@@ -0,0 +1,139 @@
+#include "fast_path.hpp"
+
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+// the number of bytes checked before the scan looks at the result, so that the checks are branch-free
+static constexpr size_t block_size = 32;
+
+static bool is_literal(const ShapePiece& piece) {
+    return !piece.optional && !piece.repeated && piece.bytes.count() == 1;
+}
+
+// ".*"
+static bool is_anything(const ShapePiece& piece) {
+    return piece.optional && piece.repeated && piece.bytes == ByteSet::all();
+}
+
+FastPath::FastPath(const Kind kind, std::string literal) : kind_(kind), literal(std::move(literal)) {}
+
+FastPath::FastPath(const ByteSet& bytes, const size_t min_length)
+    : kind_(Kind::Class), bytes(bytes), min_length(min_length) {
+
+    size_t count = 0;
+    bytes.for_each_range([this, &count](const unsigned char lower, const unsigned char upper) {
+        if (count < ranges.size()) {
+            ranges[count] = Range{lower, static_cast<uint8_t>(upper - lower)};
+        }
+        count++;
+    });
+
+    if (count == 0 || count > ranges.size()) {
+        return;
+    }
+
+    // the unused ranges repeat the first one, so that the scan checks a fixed number of ranges
+    for (size_t i = count; i < ranges.size(); i++) {
+        ranges[i] = ranges[0];
+    }
+    in_ranges = true;
+
+}
+
+std::shared_ptr<const FastPath> FastPath::classify(const std::vector<ShapePiece>& shape) {
+
+    if (shape.size() == 1 && shape[0].repeated) {
+        return std::make_shared<FastPath>(shape[0].bytes, shape[0].optional ? 0 : 1);
+    }
+
+    const bool leading = !shape.empty() && is_anything(shape.front());
+    const bool trailing = shape.size() > 1 && is_anything(shape.back());
+
+    std::string literal;
+    for (size_t i = leading ? 1 : 0; i < shape.size() - (trailing ? 1 : 0); i++) {
+        if (!is_literal(shape[i])) {
+            return nullptr;
+        }
+        for (unsigned c = 0; c < 256; c++) {
+            if (shape[i].bytes.contains(static_cast<unsigned char>(c))) {
+                literal += static_cast<char>(c);
+            }
+        }
+    }
+
+    if (leading && trailing) {
+        return literal.empty() ? std::make_shared<FastPath>(ByteSet::all(), 0)
+                               : std::make_shared<FastPath>(Kind::Contains, std::move(literal));
+    }
+    if (leading) {
+        return std::make_shared<FastPath>(Kind::Suffix, std::move(literal));
+    }
+    if (trailing) {
+        return std::make_shared<FastPath>(Kind::Prefix, std::move(literal));
+    }
+
+    return std::make_shared<FastPath>(Kind::Literal, std::move(literal));
+
+}
+
+bool FastPath::all_in_class(const unsigned char* begin, const size_t length) const {
+
+    if (!in_ranges) {
+        for (size_t i = 0; i < length; i++) {
+            if (!bytes.contains(begin[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const auto outside = [this](const unsigned char c) {
+        bool inside = false;
+        for (const Range& range : ranges) {
+            inside |= static_cast<uint8_t>(c - range.lower) <= range.span;
+        }
+        return !inside;
+    };
+
+    size_t i = 0;
+
+    for (; i + block_size <= length; i += block_size) {
+        bool any_outside = false;
+        for (size_t j = 0; j < block_size; j++) {
+            any_outside |= outside(begin[i + j]);
+        }
+        if (any_outside) {
+            return false;
+        }
+    }
+
+    for (; i < length; i++) {
+        if (outside(begin[i])) {
+            return false;
+        }
+    }
+
+    return true;
+
+}
+
+bool FastPath::matches(const char* begin, const size_t length) const {
+
+    switch (kind_) {
+        case Kind::Literal:
+            return length == literal.size() && std::memcmp(begin, literal.data(), length) == 0;
+        case Kind::Class:
+            return length >= min_length && all_in_class(reinterpret_cast<const unsigned char*>(begin), length);
+        case Kind::Prefix:
+            return length >= literal.size() && std::memcmp(begin, literal.data(), literal.size()) == 0;
+        case Kind::Suffix:
+            return length >= literal.size() &&
+                   std::memcmp(begin + (length - literal.size()), literal.data(), literal.size()) == 0;
+        case Kind::Contains:
+            return std::string_view(begin, length).find(literal) != std::string_view::npos;
+    }
+
+    return false;
+
+}
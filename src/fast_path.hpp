@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "byte_set.hpp"
+#include "matcher.hpp"
+
+// A piece of a regex without alternatives: a single byte of the set, which may be optional, repeated, or both.
+// A regex that is just a sequence of such pieces has a shape, see Expression::shape.
+struct ShapePiece {
+    ByteSet bytes;
+    bool optional = false;
+    bool repeated = false;
+};
+
+// FastPath matches regexes of a few trivial shapes with built-in kernels, without MimIR and without compiling
+// anything, so they start at once and run at memory speed:
+// - a literal, e.g. "GET /index.html", with a length compare and memcmp,
+// - a class with a star or plus, e.g. "\d+" or "[a-z]*", with a scan that checks many bytes at once,
+// - a literal followed by ".*", e.g. "ERROR.*", with a prefix compare,
+// - ".*" followed by a literal, or a literal between two ".*", with a suffix compare or a substring search.
+class FastPath final : public MatchEngine {
+
+public:
+    enum class Kind : uint8_t {
+        Literal,
+        Class,
+        Prefix,
+        Suffix,
+        Contains
+    };
+
+private:
+    // a range of bytes as its lowest byte and its width minus one
+    struct Range {
+        uint8_t lower;
+        uint8_t span;
+    };
+
+    Kind kind_;
+    std::string literal;
+
+    // Class: the bytes, the shortest line and, if the set has few ranges, the ranges
+    ByteSet bytes;
+    size_t min_length = 0;
+    std::array<Range, 4> ranges{};
+    bool in_ranges = false;
+
+    [[nodiscard]] bool all_in_class(const unsigned char* begin, size_t length) const;
+
+public:
+    // A matcher for the kind of literal.
+    explicit FastPath(Kind kind, std::string literal);
+
+    // A matcher for lines of at least min_length bytes of the set.
+    explicit FastPath(const ByteSet& bytes, size_t min_length);
+
+    // The matcher for a regex of the shape, or null if the shape is not one of the trivial ones.
+    [[nodiscard]] static std::shared_ptr<const FastPath> classify(const std::vector<ShapePiece>& shape);
+
+    [[nodiscard]] Kind kind() const {
+        return kind_;
+    }
+
+    [[nodiscard]] bool matches(const char* begin, size_t length) const override;
+
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "result_format.hpp"
+
+// FrameEncoder turns the results of the lines of one file into frames of the binary result output
+// described in result_format.hpp, and writes every frame to a sink as soon as it is full.
+//
+// Lines are either added one at a time, or as a bitmap of many lines at once, e.g. the results of a chunk
+// that has been matched on another thread. Sink is either an OutputWriter or a StringOutput.
+class FrameEncoder final {
+
+    ResultFrameKind kind;
+    uint32_t file_index;
+
+    std::unique_ptr<unsigned char[]> frame;
+    // entries in the payload of the current frame
+    size_t count = 0;
+    // first line of the current frame and the line after the last line added
+    uint64_t first_line = 0;
+    uint64_t next_line = 0;
+
+    // bitmap frames: bits of the current word that are not yet stored in the payload
+    uint64_t word = 0;
+    unsigned word_bits = 0;
+
+    template<typename Sink>
+    void emit(Sink& sink, uint64_t end_line, bool last);
+
+    template<typename Sink>
+    void store_word(Sink& sink);
+
+    template<typename Sink>
+    void add_index(Sink& sink, uint64_t line);
+
+    // Adds the results of n <= 64 lines, given by the lowest n bits of bits.
+    template<typename Sink>
+    void add_bits(Sink& sink, uint64_t bits, unsigned n);
+
+public:
+    FrameEncoder(const ResultFrameKind kind, const uint32_t file_index)
+        : kind(kind), file_index(file_index), frame(std::make_unique<unsigned char[]>(result_frame_size)) {}
+
+    template<typename Sink>
+    void add(Sink& sink, const bool selected) {
+        add_bits(sink, selected ? 1 : 0, 1);
+    }
+
+    // Adds the results of the next line_count lines, where bit i % 64 of bits[i / 64] belongs to line i.
+    template<typename Sink>
+    void append(Sink& sink, const std::vector<uint64_t>& bits, size_t line_count);
+
+    // Writes the last frame of the file.
+    template<typename Sink>
+    void finish(Sink& sink) {
+        if (kind == ResultFrameKind::Bitmap && word_bits > 0) {
+            store_little_endian(frame.get() + result_header_size + count / 64 * 8, word);
+            count += word_bits;
+        }
+        emit(sink, next_line, true);
+    }
+
+};
+
+template<typename Sink>
+void FrameEncoder::emit(Sink& sink, const uint64_t end_line, const bool last) {
+
+    unsigned char* header = frame.get();
+
+    std::memcpy(header, result_magic, sizeof(result_magic));
+    store_little_endian(header + 4, result_format_version);
+    header[6] = static_cast<unsigned char>(kind);
+    header[7] = last ? result_last_frame_flag : 0;
+    store_little_endian(header + 8, file_index);
+    store_little_endian(header + 12, static_cast<uint32_t>(count));
+    store_little_endian(header + 16, first_line);
+    store_little_endian(header + 24, end_line - first_line);
+
+    sink.write(reinterpret_cast<const char*>(frame.get()), result_frame_size);
+
+    std::memset(frame.get(), 0, result_frame_size);
+    count = 0;
+    first_line = end_line;
+
+}
+
+template<typename Sink>
+void FrameEncoder::store_word(Sink& sink) {
+
+    store_little_endian(frame.get() + result_header_size + count / 64 * 8, word);
+    count += 64;
+
+    if (count == result_frame_bits) {
+        emit(sink, first_line + count, false);
+    }
+
+}
+
+template<typename Sink>
+void FrameEncoder::add_index(Sink& sink, const uint64_t line) {
+
+    store_little_endian(frame.get() + result_header_size + count * 8, line);
+    count++;
+
+    if (count == result_frame_indices) {
+        emit(sink, line + 1, false);
+    }
+
+}
+
+template<typename Sink>
+void FrameEncoder::add_bits(Sink& sink, uint64_t bits, const unsigned n) {
+
+    if (kind == ResultFrameKind::Indices) {
+        while (bits != 0) {
+            add_index(sink, next_line + std::countr_zero(bits));
+            bits &= bits - 1;
+        }
+        next_line += n;
+        return;
+    }
+
+    next_line += n;
+    word |= bits << word_bits;
+
+    if (word_bits + n < 64) {
+        word_bits += n;
+        return;
+    }
+
+    // the word is complete, the remaining bits start the next one
+    const unsigned stored = 64 - word_bits;
+    store_word(sink);
+    word = stored == 64 ? 0 : bits >> stored;
+    word_bits = n - stored;
+
+}
+
+template<typename Sink>
+void FrameEncoder::append(Sink& sink, const std::vector<uint64_t>& bits, const size_t line_count) {
+
+    for (size_t i = 0; i * 64 < line_count; i++) {
+        const auto n = static_cast<unsigned>(std::min<size_t>(line_count - i * 64, 64));
+        const uint64_t mask = n == 64 ? ~uint64_t{0} : (uint64_t{1} << n) - 1;
+        add_bits(sink, bits[i] & mask, n);
+    }
+
+}
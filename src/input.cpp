@@ -0,0 +1,146 @@
+#include "input.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::vector<InputFile::Chunk> InputFile::split_lines(const size_t chunk_size) const {
+
+    std::vector<Chunk> chunks;
+    size_t begin = 0;
+
+    while (begin < size) {
+
+        size_t end = std::min(begin + std::max<size_t>(chunk_size, 1), size);
+
+        if (end < size && data[end - 1] != '\n') {
+            const auto* newline = static_cast<const char*>(std::memchr(data + end, '\n', size - end));
+            end = newline == nullptr ? size : static_cast<size_t>(newline - data) + 1;
+        }
+
+        chunks.push_back(Chunk{begin, end});
+        begin = end;
+    }
+
+    return chunks;
+
+}
+
+static InputError open_error(const std::string& file_name) {
+    return InputError("0: error: could not open file '" + file_name + "' for reading.");
+}
+
+#ifndef _WIN32
+
+InputFile::InputFile(const std::string& file_name) {
+
+    const int fd = ::open(file_name.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        throw open_error(file_name);
+    }
+
+    struct stat st {};
+
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw open_error(file_name);
+    }
+
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+
+        size = static_cast<size_t>(st.st_size);
+
+        // read-only, so the pages are never copied and stay shared with the page cache
+        void* address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (address != MAP_FAILED) {
+
+            data = static_cast<const char*>(address);
+            mapped = true;
+
+            // both are hints only, failure is not an error
+            ::madvise(address, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+            ::madvise(address, size, MADV_HUGEPAGE);
+#endif
+
+            ::close(fd);
+            return;
+        }
+
+        size = 0;
+    }
+
+    try {
+        read_fallback(fd);
+    }
+    catch (...) {
+        ::close(fd);
+        throw;
+    }
+
+    ::close(fd);
+
+}
+
+void InputFile::read_fallback(const int fd) {
+
+    constexpr size_t block_size = 1 << 16;
+
+    size_t used = 0;
+
+    while (true) {
+
+        if (buffer.size() < used + block_size) {
+            buffer.resize(std::max(buffer.size() * 2, used + block_size));
+        }
+
+        const ssize_t n = ::read(fd, buffer.data() + used, block_size);
+
+        if (n < 0) {
+            throw InputError("0: error: failed to read input.");
+        }
+
+        if (n == 0) {
+            break;
+        }
+
+        used += static_cast<size_t>(n);
+    }
+
+    buffer.resize(used);
+
+    data = buffer.data();
+    size = used;
+
+}
+
+InputFile::~InputFile() {
+    if (mapped) {
+        ::munmap(const_cast<char*>(data), size);
+    }
+}
+
+#else
+
+InputFile::InputFile(const std::string& file_name) {
+    std::ifstream stream(file_name, std::ios::binary);
+    if (!stream.is_open()) {
+        throw open_error(file_name);
+    }
+    buffer.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    size = buffer.size();
+    data = buffer.data();
+}
+
+InputFile::~InputFile() = default;
+
+#endif
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "consumer.hpp"
+
+// Thrown if an input file cannot be opened or read.
+class InputError final : public std::runtime_error {
+
+public:
+    explicit InputError(const std::string& message) : std::runtime_error(message) {}
+
+};
+
+// InputFile gives the line-matching loop direct access to the bytes of an input file.
+//
+// Regular files are memory-mapped read-only, and every line is handed out as a span of the mapping, without
+// being copied into a std::string or written to, so the pages of the file stay shared with the page cache.
+// Inputs that cannot be mapped (pipes, character devices, files reporting a size of zero, ...) are read into a
+// heap buffer instead.
+class InputFile final {
+
+    const char* data = nullptr;
+    size_t size = 0;
+
+    bool mapped = false;
+
+    std::string buffer;
+
+#ifndef _WIN32
+    void read_fallback(int fd);
+#endif
+
+public:
+    // Opens the file for reading, throws InputError if this is not possible.
+    explicit InputFile(const std::string& file_name);
+
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+
+    ~InputFile();
+
+    [[nodiscard]] size_t length() const {
+        return size;
+    }
+
+    [[nodiscard]] bool is_mapped() const {
+        return mapped;
+    }
+
+    // The raw bytes of the file.
+    [[nodiscard]] std::string_view contents() const {
+        return {data, size};
+    }
+
+    // A range [begin, end) of complete lines of the file, given as byte offsets.
+    struct Chunk {
+        size_t begin;
+        size_t end;
+    };
+
+    // Splits the file into consecutive chunks of roughly chunk_size bytes, each ending right after a '\n'
+    // or at the end of the file.
+    [[nodiscard]] std::vector<Chunk> split_lines(size_t chunk_size) const;
+
+    // Calls consumer(line, line_length) for every line of the file, in order. The line points into the file
+    // and is not terminated: the line separator '\n' follows it, except at the end of the file. Like
+    // std::getline, a trailing '\n' does not start an extra empty line.
+    // The iteration stops early if the consumer returns false.
+    template<typename Consumer>
+    void for_each_line(Consumer&& consumer) const {
+        for_each_line(Chunk{0, size}, std::forward<Consumer>(consumer));
+    }
+
+    // Same as above, restricted to the lines of the given chunk.
+    // Different chunks may be iterated concurrently.
+    template<typename Consumer>
+    void for_each_line(Chunk chunk, Consumer&& consumer) const;
+
+};
+
+template<typename Consumer>
+void InputFile::for_each_line(const Chunk chunk, Consumer&& consumer) const {
+
+    const char* cursor = data + chunk.begin;
+    const char* const end = data + chunk.end;
+
+    while (cursor < end) {
+
+        const auto* newline = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+
+        if (newline == nullptr) {
+            break;
+        }
+
+        if (!consume(consumer, cursor, static_cast<size_t>(newline - cursor))) {
+            return;
+        }
+        cursor = newline + 1;
+    }
+
+    // last line of the file without a trailing newline
+    if (cursor < end) {
+        consume(consumer, cursor, static_cast<size_t>(end - cursor));
+    }
+
+}
@@ -0,0 +1,294 @@
+#include "jit.hpp"
+
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/MC/MCSubtargetInfo.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+
+// Keeps a copy of the object code the JIT produces, so that it can be stored in a MatcherCache.
+class ObjectCapture final : public llvm::ObjectCache {
+
+public:
+    std::string object;
+
+    void notifyObjectCompiled(const llvm::Module*, const llvm::MemoryBufferRef buffer) override {
+        object.assign(buffer.getBufferStart(), buffer.getBufferSize());
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module*) override {
+        return nullptr;
+    }
+
+};
+
+struct JitCompiler::State {
+    ObjectCapture capture;
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+    // the machine the code is compiled for, which the IR optimizations are tuned to
+    std::unique_ptr<llvm::TargetMachine> machine;
+    CodeGenOptions options;
+};
+
+static std::runtime_error jit_error(const std::string& what, llvm::Error error) {
+    return std::runtime_error("0: error: " + what + ": " + llvm::toString(std::move(error)));
+}
+
+static llvm::CodeGenOpt::Level codegen_level(const int opt_level) {
+    switch (opt_level) {
+        case 0: return llvm::CodeGenOpt::None;
+        case 1: return llvm::CodeGenOpt::Less;
+        case 2: return llvm::CodeGenOpt::Default;
+        default: return llvm::CodeGenOpt::Aggressive;
+    }
+}
+
+static llvm::OptimizationLevel ir_level(const int opt_level) {
+    switch (opt_level) {
+        case 0: return llvm::OptimizationLevel::O0;
+        case 1: return llvm::OptimizationLevel::O1;
+        case 2: return llvm::OptimizationLevel::O2;
+        default: return llvm::OptimizationLevel::O3;
+    }
+}
+
+JitCompiler::JitCompiler(const CodeGenOptions& options) : state(std::make_unique<State>()) {
+
+    static std::once_flag targets_initialized;
+    std::call_once(targets_initialized, [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+        llvm::InitializeNativeTargetAsmParser();
+    });
+
+    state->options = options;
+
+    if (state->options.mtune == "native") {
+        state->options.mtune = llvm::sys::getHostCPUName().str();
+    }
+
+    auto machine = llvm::orc::JITTargetMachineBuilder::detectHost();
+
+    if (!machine) {
+        throw jit_error("Failed to set up the JIT", machine.takeError());
+    }
+
+    // LLVM only warns about CPUs it does not know and then compiles for a generic one
+    std::string lookup_error;
+    const std::string triple = machine->getTargetTriple().str();
+
+    if (const llvm::Target* target = llvm::TargetRegistry::lookupTarget(triple, lookup_error)) {
+        const std::unique_ptr<llvm::MCSubtargetInfo> subtarget(target->createMCSubtargetInfo(triple, "", ""));
+        for (const std::string& cpu : {options.march, state->options.mtune}) {
+            if (!cpu.empty() && cpu != "native" && !subtarget->isCPUStringValid(cpu)) {
+                throw std::runtime_error("0: error: unknown target CPU '" + cpu + "'.");
+            }
+        }
+    }
+
+    // the host CPU and its features are the default, another CPU brings its own features
+    if (!options.march.empty() && options.march != "native") {
+        machine->setCPU(options.march);
+        machine->setFeatures("");
+    }
+
+    machine->setCodeGenOptLevel(codegen_level(options.opt_level));
+
+    auto target_machine = machine->createTargetMachine();
+
+    if (!target_machine) {
+        throw jit_error("Failed to set up the JIT for CPU '" + machine->getCPU() + "'", target_machine.takeError());
+    }
+
+    state->machine = std::move(*target_machine);
+
+    using Compiler = llvm::orc::IRCompileLayer::IRCompiler;
+
+    // compiles like the default, but hands every object to the capture
+    const auto make_compiler = [capture = &state->capture](llvm::orc::JITTargetMachineBuilder machine)
+        -> llvm::Expected<std::unique_ptr<Compiler>> {
+        return std::make_unique<llvm::orc::ConcurrentIRCompiler>(std::move(machine), capture);
+    };
+
+    auto jit = llvm::orc::LLJITBuilder()
+                   .setJITTargetMachineBuilder(std::move(*machine))
+                   .setCompileFunctionCreator(make_compiler)
+                   .create();
+
+    if (!jit) {
+        throw jit_error("Failed to set up the JIT", jit.takeError());
+    }
+
+    state->jit = std::move(*jit);
+
+    // the generated code may call into the C library, e.g. for memcpy
+    auto process_symbols = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        state->jit->getDataLayout().getGlobalPrefix());
+
+    if (!process_symbols) {
+        throw jit_error("Failed to set up the JIT", process_symbols.takeError());
+    }
+
+    state->jit->getMainJITDylib().addGenerator(std::move(*process_symbols));
+
+}
+
+// Runs the IR optimizations of the options' level on the module.
+static void optimize(llvm::Module& module, llvm::TargetMachine& machine, const CodeGenOptions& options) {
+
+    if (!options.mtune.empty()) {
+        for (llvm::Function& function : module) {
+            if (!function.isDeclaration()) {
+                function.addFnAttr("tune-cpu", options.mtune);
+            }
+        }
+    }
+
+    if (options.opt_level <= 0) {
+        return;
+    }
+
+    // the same pipeline as clang -O<n>
+    llvm::LoopAnalysisManager loops;
+    llvm::FunctionAnalysisManager functions;
+    llvm::CGSCCAnalysisManager call_graph;
+    llvm::ModuleAnalysisManager modules;
+
+    llvm::PassBuilder builder(&machine);
+    builder.registerModuleAnalyses(modules);
+    builder.registerCGSCCAnalyses(call_graph);
+    builder.registerFunctionAnalyses(functions);
+    builder.registerLoopAnalyses(loops);
+    builder.crossRegisterProxies(loops, functions, call_graph, modules);
+
+    builder.buildPerModuleDefaultPipeline(ir_level(options.opt_level)).run(module, modules);
+
+}
+
+static std::unique_ptr<llvm::Module> parse(const std::string& ir, const std::string& name,
+                                           llvm::LLVMContext& context) {
+
+    llvm::SMDiagnostic diagnostic;
+    std::unique_ptr<llvm::Module> module = llvm::parseIR(llvm::MemoryBufferRef(ir, name), diagnostic, context);
+
+    if (!module) {
+        std::string message;
+        llvm::raw_string_ostream stream(message);
+        diagnostic.print(nullptr, stream, false);
+        throw std::runtime_error("0: error: Failed to parse the generated LLVM IR: " + stream.str());
+    }
+
+    return module;
+
+}
+
+JitCompiler::~JitCompiler() = default;
+
+void JitCompiler::add_module(const std::string& ir, const std::string& name) {
+
+    auto context = std::make_unique<llvm::LLVMContext>();
+    std::unique_ptr<llvm::Module> module = parse(ir, name, *context);
+
+    // the IR does not name a target, so compile it for the host like clang would
+    module->setTargetTriple(state->jit->getTargetTriple().str());
+    module->setDataLayout(state->jit->getDataLayout());
+
+    optimize(*module, *state->machine, state->options);
+
+    if (llvm::Error error = state->jit->addIRModule(
+            llvm::orc::ThreadSafeModule(std::move(module), std::move(context)))) {
+        throw jit_error("Failed to add the generated module to the JIT", std::move(error));
+    }
+
+}
+
+void JitCompiler::add_object_file(const std::string& path) {
+
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+
+    if (!buffer) {
+        throw std::runtime_error("0: error: Failed to read object file '" + path + "': " + buffer.getError().message());
+    }
+
+    if (llvm::Error error = state->jit->addObjectFile(std::move(*buffer))) {
+        throw jit_error("Failed to add object file '" + path + "' to the JIT", std::move(error));
+    }
+
+}
+
+void JitCompiler::write_bitcode(const std::string& ir, const std::string& path) {
+
+    llvm::LLVMContext context;
+    const std::unique_ptr<llvm::Module> module = parse(ir, path, context);
+
+    std::error_code error;
+    llvm::raw_fd_ostream file(path, error, llvm::sys::fs::OF_None);
+
+    if (!error) {
+        llvm::WriteBitcodeToFile(*module, file);
+        file.close();
+        error = file.error();
+    }
+
+    if (error) {
+        throw std::runtime_error("0: error: Failed to write bitcode file '" + path + "': " + error.message());
+    }
+
+}
+
+const std::string& JitCompiler::compiled_object() const {
+    return state->capture.object;
+}
+
+std::string JitCompiler::target_identity() {
+
+    std::string identity =
+        "LLVM " LLVM_VERSION_STRING " " + llvm::sys::getProcessTriple() + " " + llvm::sys::getHostCPUName().str();
+
+    // the code uses the features of the host CPU, which differ e.g. between virtual machines with the same CPU
+    if (auto machine = llvm::orc::JITTargetMachineBuilder::detectHost()) {
+        identity += " " + machine->getFeatures().getString();
+    }
+    else {
+        llvm::consumeError(machine.takeError());
+    }
+
+    return identity;
+
+}
+
+void* JitCompiler::lookup(const std::string& symbol) const {
+
+    auto address = state->jit->lookup(symbol);
+
+    if (!address) {
+        throw jit_error("Failed to compile '" + symbol + "'", address.takeError());
+    }
+
+#if LLVM_VERSION_MAJOR >= 15
+    return address->toPtr<void*>();
+#else
+    return reinterpret_cast<void*>(static_cast<uintptr_t>(address->getAddress()));
+#endif
+
+}
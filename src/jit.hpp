@@ -0,0 +1,52 @@
+#pragma once
+
+#include "codegen_options.hpp"
+
+#include <memory>
+#include <string>
+
+// JitCompiler compiles textual LLVM IR in memory with LLVM's ORC JIT and makes its functions callable from
+// this process, without running an external compiler or writing anything to the file system.
+//
+// Only available if the project is configured with LLVM, i.e. if REGEXFE_HAVE_LLVM_JIT is defined.
+// The LLVM headers are confined to jit.cpp.
+class JitCompiler final {
+
+    struct State;
+    std::unique_ptr<State> state;
+
+public:
+    // Sets up a JIT that compiles for the host, or for the CPU given by the options.
+    // Throws std::runtime_error if that is not possible, e.g. if LLVM does not know the CPU.
+    explicit JitCompiler(const CodeGenOptions& options = {});
+
+    JitCompiler(const JitCompiler&) = delete;
+    JitCompiler& operator=(const JitCompiler&) = delete;
+
+    // Frees the compiled code, every function pointer obtained from lookup becomes invalid.
+    ~JitCompiler();
+
+    // Parses and adds the module, which is compiled on the first lookup of one of its symbols.
+    // Throws std::runtime_error if the IR cannot be parsed.
+    void add_module(const std::string& ir, const std::string& name);
+
+    // Adds an object file, e.g. one that was stored from compiled_object() by an earlier run.
+    // Throws std::runtime_error if the file cannot be read.
+    void add_object_file(const std::string& path);
+
+    // Parses the IR and writes it to the file as bitcode, which clang reads faster than text.
+    // Throws std::runtime_error if the IR cannot be parsed or the file cannot be written.
+    static void write_bitcode(const std::string& ir, const std::string& path);
+
+    // The object code of the module compiled last, empty if no module has been compiled yet.
+    [[nodiscard]] const std::string& compiled_object() const;
+
+    // Identifies the LLVM version and the host CPU the code is compiled for, with its features,
+    // i.e. everything besides the IR and the CodeGenOptions that the object code depends on.
+    [[nodiscard]] static std::string target_identity();
+
+    // Returns the address of the function with the given name.
+    // Throws std::runtime_error if the function does not exist, or if compiling its module fails.
+    [[nodiscard]] void* lookup(const std::string& symbol) const;
+
+};
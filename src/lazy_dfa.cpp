@@ -0,0 +1,376 @@
+#include "lazy_dfa.hpp"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+// transitions that have not been computed yet, and those to the state without threads, which never matches
+constexpr uint32_t unknown = std::numeric_limits<uint32_t>::max();
+constexpr uint32_t dead = unknown - 1;
+
+// Once the cache has been flushed this often in one match, and the match has not consumed this many bytes
+// per state it built, the DFA is slower than the Pike VM would be.
+constexpr size_t max_flushes = 4;
+constexpr size_t min_bytes_per_state = 10;
+
+// the bookkeeping of a state besides its row of transitions and its threads, estimated
+constexpr size_t state_overhead = 96;
+
+struct ThreadsHash {
+    size_t operator()(const std::vector<uint32_t>& threads) const {
+        size_t hash = threads.size();
+        for (const uint32_t thread : threads) {
+            hash ^= thread + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        }
+        return hash;
+    }
+};
+
+}
+
+struct LazyDfa::Cache {
+
+    struct State {
+        // the sorted instructions of the threads, i.e. the Byte and Match instructions reached without consuming input
+        std::vector<uint32_t> threads;
+        bool accepting;
+    };
+
+    std::vector<State> states;
+    // one row per state, one column per byte class
+    std::vector<uint32_t> transitions;
+    std::unordered_map<std::vector<uint32_t>, uint32_t, ThreadsHash> index;
+    uint32_t start = unknown;
+    size_t bytes = 0;
+
+    // statistics of the current match
+    size_t flushes = 0;
+    size_t built = 0;
+
+    // scratch space to compute the threads of a state
+    std::vector<uint32_t> threads;
+    std::vector<uint32_t> stack;
+    std::vector<uint32_t> seen;
+    uint32_t generation = 0;
+
+    void clear() {
+        states.clear();
+        transitions.clear();
+        index.clear();
+        start = unknown;
+        bytes = 0;
+        flushes++;
+    }
+
+    // Adds the thread at the instruction and every thread it continues with without consuming input.
+    void follow(const PikeProgram& program, const uint32_t instruction) {
+
+        stack.push_back(instruction);
+
+        while (!stack.empty()) {
+            const uint32_t index = stack.back();
+            stack.pop_back();
+
+            if (seen[index] == generation) {
+                continue;
+            }
+            seen[index] = generation;
+
+            if (const PikeProgram::Instruction& split = program.instruction(index);
+                split.opcode == PikeProgram::Opcode::Split) {
+                stack.push_back(split.alternative);
+                stack.push_back(split.next);
+            }
+            else {
+                threads.push_back(index);
+            }
+        }
+
+    }
+
+    // Starts computing the threads of a new state.
+    void begin_threads(const size_t instructions) {
+        threads.clear();
+        if (seen.size() < instructions) {
+            seen.resize(instructions, generation);
+        }
+        // wrapping around would make old marks look current
+        if (++generation == 0) {
+            std::fill(seen.begin(), seen.end(), 0);
+            generation = 1;
+        }
+    }
+
+};
+
+LazyDfa::LazyDfa(PikeProgram program, const size_t cache_bytes)
+    : program(std::move(program)), cache_bytes(cache_bytes) {
+
+    const size_t classes = this->program.byte_classes(byte_classes);
+    representatives.resize(classes);
+    for (unsigned byte = 256; byte-- > 0;) {
+        representatives[byte_classes[byte]] = static_cast<uint8_t>(byte);
+    }
+
+}
+
+LazyDfa::~LazyDfa() = default;
+
+std::unique_ptr<LazyDfa::Cache> LazyDfa::borrow() const {
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!idle.empty()) {
+            std::unique_ptr<Cache> cache = std::move(idle.back());
+            idle.pop_back();
+            return cache;
+        }
+    }
+
+    return std::make_unique<Cache>();
+
+}
+
+void LazyDfa::give_back(std::unique_ptr<Cache> cache) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    idle.push_back(std::move(cache));
+}
+
+// Adds the state with the threads, unless the cache has it already, and returns its index.
+// The caller makes room for the state first.
+uint32_t LazyDfa::add_state(Cache& cache, const std::vector<uint32_t>& threads) const {
+
+    if (const auto found = cache.index.find(threads); found != cache.index.end()) {
+        return found->second;
+    }
+
+    const auto state = static_cast<uint32_t>(cache.states.size());
+    // the Match instruction is the first one
+    cache.states.push_back(Cache::State{threads, !threads.empty() && threads.front() == PikeProgram::match()});
+    cache.transitions.resize(cache.transitions.size() + representatives.size(), unknown);
+    cache.index.emplace(threads, state);
+    cache.bytes += state_bytes(threads.size());
+    cache.built++;
+
+    return state;
+
+}
+
+size_t LazyDfa::state_bytes(const size_t threads) const {
+    // the threads are stored twice, in the state and as the key of the index
+    return representatives.size() * sizeof(uint32_t) + 2 * threads * sizeof(uint32_t) + state_overhead;
+}
+
+uint32_t LazyDfa::start_state(Cache& cache) const {
+
+    if (cache.start != unknown) {
+        return cache.start;
+    }
+
+    cache.begin_threads(program.size());
+    cache.follow(program, program.entry());
+    std::sort(cache.threads.begin(), cache.threads.end());
+
+    if (cache.bytes + state_bytes(cache.threads.size()) > cache_bytes) {
+        cache.clear();
+    }
+    cache.start = add_state(cache, cache.threads);
+
+    return cache.start;
+
+}
+
+// Computes the transition of the state over the byte class. Should the cache be flushed to make room for the
+// next state, the current state is added again and its new index is stored in state.
+uint32_t LazyDfa::next_state(Cache& cache, uint32_t& state, const uint8_t byte_class) const {
+
+    // every thread of the state that consumes the byte continues in the next state
+    const uint8_t byte = representatives[byte_class];
+    cache.begin_threads(program.size());
+    for (const uint32_t index : cache.states[state].threads) {
+        if (const PikeProgram::Instruction& instruction = program.instruction(index);
+            instruction.opcode == PikeProgram::Opcode::Byte && instruction.bytes.contains(byte)) {
+            cache.follow(program, instruction.next);
+        }
+    }
+
+    if (cache.threads.empty()) {
+        cache.transitions[state * representatives.size() + byte_class] = dead;
+        return dead;
+    }
+
+    std::sort(cache.threads.begin(), cache.threads.end());
+
+    if (!cache.index.contains(cache.threads) && cache.bytes + state_bytes(cache.threads.size()) > cache_bytes) {
+        // the match goes on from the current state, so it survives the flush
+        const std::vector<uint32_t> current = cache.states[state].threads;
+        cache.clear();
+        state = add_state(cache, current);
+    }
+
+    const uint32_t next = add_state(cache, cache.threads);
+    cache.transitions[state * representatives.size() + byte_class] = next;
+
+    return next;
+
+}
+
+// Runs the DFA over the span. Sets give_up instead if the DFA is not worth it for this span.
+bool LazyDfa::run(Cache& cache, const char* begin, const size_t length, bool& give_up) const {
+
+    cache.flushes = 0;
+    cache.built = 0;
+    give_up = false;
+
+    const size_t classes = representatives.size();
+    uint32_t state = start_state(cache);
+
+    for (size_t i = 0; i < length; i++) {
+        const uint8_t byte_class = byte_classes[static_cast<unsigned char>(begin[i])];
+        uint32_t next = cache.transitions[state * classes + byte_class];
+
+        if (next >= dead) [[unlikely]] {
+            if (next == unknown) {
+                next = next_state(cache, state, byte_class);
+                give_up = cache.flushes > max_flushes && i < min_bytes_per_state * cache.built;
+            }
+            if (next == dead || give_up) {
+                return false;
+            }
+        }
+
+        state = next;
+    }
+
+    return cache.states[state].accepting;
+
+}
+
+bool LazyDfa::matches(const char* begin, const size_t length) const {
+
+    std::unique_ptr<Cache> cache = borrow();
+    bool give_up;
+    const bool result = run(*cache, begin, length, give_up);
+    give_back(std::move(cache));
+
+    if (give_up) {
+        return program.matches(begin, length);
+    }
+
+    return result;
+
+}
+
+// Interleaves the walks over several spans, so that the table lookups of one span overlap with those of the
+// others instead of waiting for each other, which matters most for short spans and tables beyond the L1 cache.
+// A lane whose span ends or dies takes up the next span of the batch.
+void LazyDfa::match_batch(const MatchSpan* spans, const size_t count, uint64_t* results) const {
+
+    std::unique_ptr<Cache> cache = borrow();
+    const size_t classes = representatives.size();
+    // the spans whose walk was interrupted by a flush of the cache, which forgets the states of all lanes
+    std::vector<size_t> interrupted;
+
+    std::array<uint32_t, lanes> states;
+    std::array<const unsigned char*, lanes> cursors;
+    std::array<const unsigned char*, lanes> ends;
+    std::array<size_t, lanes> indices;
+    size_t width = 0;
+    size_t next_span = 0;
+
+    uint32_t start = start_state(*cache);
+    size_t flushes = cache->flushes;
+
+    const auto retire = [&](const size_t lane) {
+        width--;
+        states[lane] = states[width];
+        cursors[lane] = cursors[width];
+        ends[lane] = ends[width];
+        indices[lane] = indices[width];
+    };
+
+    while (true) {
+        while (width < lanes && next_span < count) {
+            states[width] = start;
+            cursors[width] = reinterpret_cast<const unsigned char*>(spans[next_span].begin);
+            ends[width] = cursors[width] + spans[next_span].length;
+            indices[width] = next_span++;
+            width++;
+        }
+
+        if (width == 0) {
+            break;
+        }
+
+        // in these rounds, no lane reaches the end of its span
+        size_t rounds = std::numeric_limits<size_t>::max();
+        for (size_t lane = 0; lane < width; lane++) {
+            rounds = std::min(rounds, static_cast<size_t>(ends[lane] - cursors[lane]));
+        }
+
+        size_t lane = 0;
+        bool missed = false;
+        for (size_t round = 0; round < rounds && !missed; round++) {
+            for (lane = 0; lane < width; lane++) {
+                const uint32_t next = cache->transitions[states[lane] * classes + byte_classes[*cursors[lane]]];
+                if (next >= dead) [[unlikely]] {
+                    missed = true;
+                    break;
+                }
+                states[lane] = next;
+                cursors[lane]++;
+            }
+        }
+
+        if (missed) {
+            const uint8_t byte_class = byte_classes[*cursors[lane]];
+            uint32_t next = cache->transitions[states[lane] * classes + byte_class];
+
+            if (next == unknown) {
+                next = next_state(*cache, states[lane], byte_class);
+                if (cache->flushes != flushes) {
+                    for (size_t other = 0; other < width; other++) {
+                        interrupted.push_back(indices[other]);
+                    }
+                    width = 0;
+                    start = start_state(*cache);
+                    flushes = cache->flushes;
+                    continue;
+                }
+            }
+
+            if (next == dead) {
+                retire(lane);
+            }
+            else {
+                states[lane] = next;
+                cursors[lane]++;
+            }
+            continue;
+        }
+
+        for (size_t lane = width; lane-- > 0;) {
+            if (cursors[lane] == ends[lane]) {
+                results[indices[lane] / 64] |=
+                    static_cast<uint64_t>(cache->states[states[lane]].accepting) << (indices[lane] % 64);
+                retire(lane);
+            }
+        }
+    }
+
+    for (const size_t index : interrupted) {
+        bool give_up;
+        bool result = run(*cache, spans[index].begin, spans[index].length, give_up);
+        if (give_up) {
+            result = program.matches(spans[index].begin, spans[index].length);
+        }
+        results[index / 64] |= static_cast<uint64_t>(result) << (index % 64);
+    }
+
+    give_back(std::move(cache));
+
+}
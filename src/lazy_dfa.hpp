@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "matcher.hpp"
+#include "pike_vm.hpp"
+
+// LazyDfa matches a regex with a DFA that is built while matching: a DFA state is the set of NFA threads
+// the Pike VM would run at that point, and the transitions out of a state are only computed the first time
+// the input takes them. Every later visit costs a single table lookup per byte, without compiling anything.
+//
+// The states and transitions live in a cache with a fixed memory budget. When a new state would exceed it,
+// the cache is flushed and the DFA is built again from the current state on, so regexes whose DFA explodes
+// still match in bounded memory. Should the cache be flushed over and over in a single match, the DFA
+// does not pay off and the match runs on the Pike VM instead.
+//
+// Bytes that no instruction tells apart share a column of the transition table, which keeps states small.
+//
+// A batch of spans is matched in lockstep, a few spans at a time, advancing each of them by one byte per round.
+//
+// The DFA is safe to call from several threads at once: every concurrent match borrows a cache of its own,
+// hence each thread matching at the same time may use up to the budget.
+class LazyDfa final : public MatchEngine {
+
+public:
+    // The memory budget of a cache unless given otherwise.
+    static constexpr size_t default_cache_bytes = size_t{2} << 20;
+
+    // The number of spans match_batch walks in lockstep.
+    static constexpr size_t lanes = 8;
+
+private:
+    struct Cache;
+
+    PikeProgram program;
+    size_t cache_bytes;
+
+    // the column of the transition table per byte and a byte of each column
+    std::array<uint8_t, 256> byte_classes{};
+    std::vector<uint8_t> representatives;
+
+    mutable std::mutex mutex;
+    mutable std::vector<std::unique_ptr<Cache>> idle;
+
+    std::unique_ptr<Cache> borrow() const;
+
+    void give_back(std::unique_ptr<Cache> cache) const;
+
+    [[nodiscard]] size_t state_bytes(size_t threads) const;
+
+    uint32_t add_state(Cache& cache, const std::vector<uint32_t>& threads) const;
+
+    uint32_t start_state(Cache& cache) const;
+
+    uint32_t next_state(Cache& cache, uint32_t& state, uint8_t byte_class) const;
+
+    bool run(Cache& cache, const char* begin, size_t length, bool& give_up) const;
+
+public:
+    explicit LazyDfa(PikeProgram program, size_t cache_bytes = default_cache_bytes);
+
+    ~LazyDfa() override;
+
+    LazyDfa(const LazyDfa&) = delete;
+    LazyDfa& operator=(const LazyDfa&) = delete;
+
+    // Whether the whole span matches, like the compiled span function. Safe to call from several threads.
+    [[nodiscard]] bool matches(const char* begin, size_t length) const override;
+
+    void match_batch(const MatchSpan* spans, size_t count, uint64_t* results) const override;
+
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+
+// LengthBounds are the shortest and the longest length of the texts a piece of the regex matches.
+// They are computed bottom-up over the AST, see Expression::lengthBounds. As regexes match whole lines,
+// a line whose length is out of the bounds of the regex cannot match.
+struct LengthBounds {
+
+    // The maximum of a piece that matches arbitrarily long texts, e.g. with a star.
+    static constexpr size_t unbounded = std::numeric_limits<size_t>::max();
+
+    size_t min = 0;
+    size_t max = unbounded;
+
+    [[nodiscard]] static LengthBounds exactly(const size_t length) {
+        return LengthBounds{length, length};
+    }
+
+    // The bounds of this piece followed by the other.
+    [[nodiscard]] LengthBounds then(const LengthBounds& other) const {
+        return LengthBounds{add(min, other.min), add(max, other.max)};
+    }
+
+    // The bounds of either this piece or the other.
+    [[nodiscard]] LengthBounds either(const LengthBounds& other) const {
+        return LengthBounds{std::min(min, other.min), std::max(max, other.max)};
+    }
+
+    // The bounds of the piece repeated at least the given number of times, and arbitrarily often.
+    // A piece that only matches the empty text stays empty.
+    [[nodiscard]] LengthBounds repeated(const size_t at_least) const {
+        return LengthBounds{at_least == 0 ? 0 : min, max == 0 ? 0 : unbounded};
+    }
+
+    // The bounds of the piece or of the empty text.
+    [[nodiscard]] LengthBounds optional() const {
+        return LengthBounds{0, max};
+    }
+
+    [[nodiscard]] bool contains(const size_t length) const {
+        return min <= length && length <= max;
+    }
+
+    // Whether some lengths are out of the bounds.
+    [[nodiscard]] bool restrictive() const {
+        return min > 0 || max != unbounded;
+    }
+
+private:
+    // saturates at unbounded
+    [[nodiscard]] static size_t add(const size_t a, const size_t b) {
+        return a > unbounded - b ? unbounded : a + b;
+    }
+
+};
@@ -1,66 +1,13 @@
 #pragma once
 
-#include <cassert>
-
-#include <sstream>
+#include <exception>
+#include <ostream>
 #include <string>
+#include <string_view>
 #include <utility>
 
-#include "strqueue.hpp"
 #include "token.hpp"
 
-class LexerBackend final {
-    std::istringstream stream;
-
-    size_t head = 0;
-    size_t peek_offset = 0;
-
-    // invariant: window is the string between head and the last character of the stream that was read so far
-    // invariant: either head = 0 and window = "" or 0 <= peek_offset < window.size()
-    StringQueue window = StringQueue("");
-
-public:
-    explicit LexerBackend(const std::string& source) : stream(source) {}
-
-    [[nodiscard]] char char_at_head() const {
-        assert(!window.empty());
-        return window.front();
-    }
-
-    [[nodiscard]] char char_at_peek() const {
-        assert(!window.empty());
-        return window.back();
-    }
-
-    [[nodiscard]] size_t head_position() const {
-        return head;
-    }
-
-    [[nodiscard]] size_t peek_position() const {
-        return head + peek_offset;
-    }
-
-    bool peek();
-    bool read();
-
-    void move_peek_to_head() {
-        peek_offset = 0;
-    }
-
-    std::string string_between_head_and_peek() const {
-        assert(!window.empty());
-        assert(peek_offset < window.size());
-        return std::string(window.view().substr(0, peek_offset));
-    }
-
-    void move_head_to_peek() {
-        head += peek_offset;
-        window.pop(peek_offset);
-        peek_offset = 0;
-    }
-
-};
-
 class LexerError final : public std::exception {
 
 public:
@@ -78,13 +25,19 @@ public:
     }
 };
 
+// The lexer scans the regex in place, indexing into it directly, so that lexing allocates nothing but errors.
+// The regex must outlive the lexer.
 class Lexer {
 
-    LexerBackend backend;
+    std::string_view source;
+
+    // the position of the first character not lexed yet
+    size_t next = 0;
 
 public:
-    explicit Lexer(const std::string& input) : backend(LexerBackend(input)) {}
+    explicit Lexer(const std::string_view source) : source(source) {}
 
+    // The next token, which is at the position of its last character, or T_EOF at the end of the regex.
     Token lex();
 
 };
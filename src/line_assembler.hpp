@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#include "consumer.hpp"
+
+// LineAssembler splits input arriving in consecutive pieces into lines.
+//
+// Lines inside a piece are handed out directly as spans of the piece, lines spanning several pieces are
+// assembled in a separate buffer. Either way consumer(line, line_length) is called without the '\n'.
+class LineAssembler final {
+
+    // beginning of a line that continues in the next piece
+    std::string carry;
+
+public:
+    // Calls consumer for every line completed by the given piece.
+    // Returns false if the consumer returned false, i.e. asked to stop.
+    template<typename Consumer>
+    bool feed(const char* data, size_t size, Consumer&& consumer);
+
+    // Calls consumer for the last line, if the input does not end with '\n'.
+    template<typename Consumer>
+    void finish(Consumer&& consumer) {
+        if (!carry.empty()) {
+            consume(consumer, static_cast<const char*>(carry.data()), carry.size());
+            carry.clear();
+        }
+    }
+
+};
+
+template<typename Consumer>
+bool LineAssembler::feed(const char* data, const size_t size, Consumer&& consumer) {
+
+    const char* cursor = data;
+    const char* const end = data + size;
+
+    if (!carry.empty()) {
+
+        const auto* newline = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+
+        if (newline == nullptr) {
+            carry.append(cursor, end);
+            return true;
+        }
+
+        carry.append(cursor, newline);
+        const bool more = consume(consumer, static_cast<const char*>(carry.data()), carry.size());
+        carry.clear();
+        if (!more) {
+            return false;
+        }
+        cursor = newline + 1;
+    }
+
+    while (cursor < end) {
+
+        const auto* newline = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+
+        if (newline == nullptr) {
+            carry.assign(cursor, end);
+            return true;
+        }
+
+        if (!consume(consumer, cursor, static_cast<size_t>(newline - cursor))) {
+            return false;
+        }
+        cursor = newline + 1;
+    }
+
+    return true;
+
+}
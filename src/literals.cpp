@@ -0,0 +1,219 @@
+#include "literals.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+void normalize(std::vector<std::string>& strings) {
+    std::sort(strings.begin(), strings.end());
+    strings.erase(std::unique(strings.begin(), strings.end()), strings.end());
+}
+
+// Drops every string that contains another string of the set, as a text containing it contains the other one, too.
+void minimize(std::vector<std::string>& strings) {
+
+    normalize(strings);
+
+    std::vector<std::string> kept;
+    for (const std::string& string : strings) {
+        const bool redundant = std::any_of(strings.begin(), strings.end(), [&](const std::string& other) {
+            return other.size() < string.size() && string.find(other) != std::string::npos;
+        });
+        if (!redundant) {
+            kept.push_back(string);
+        }
+    }
+    strings = std::move(kept);
+
+}
+
+// Every string of the first set followed by every string of the second, unless there are too many.
+std::optional<std::vector<std::string>> product(const std::vector<std::string>& first,
+                                                const std::vector<std::string>& second) {
+
+    if (first.size() * second.size() > LiteralInfo::max_strings) {
+        return std::nullopt;
+    }
+
+    std::vector<std::string> strings;
+    for (const std::string& prefix : first) {
+        for (const std::string& suffix : second) {
+            strings.push_back(prefix + suffix);
+        }
+    }
+    normalize(strings);
+
+    return strings;
+
+}
+
+// The length of the shortest string, 0 for an empty set, which requires nothing.
+size_t shortest(const std::vector<std::string>& strings) {
+
+    if (strings.empty()) {
+        return 0;
+    }
+
+    return std::min_element(strings.begin(), strings.end(), [](const std::string& a, const std::string& b) {
+        return a.size() < b.size();
+    })->size();
+
+}
+
+// Keeps the candidate if it is the better requirement: its shortest string is longer, or it has fewer strings.
+void consider(std::vector<std::string>& best, std::vector<std::string> candidate) {
+
+    minimize(candidate);
+
+    const size_t candidate_length = shortest(candidate);
+    const size_t best_length = shortest(best);
+    if (candidate_length > best_length || (candidate_length == best_length && candidate_length > 0 &&
+                                           candidate.size() < best.size())) {
+        best = std::move(candidate);
+    }
+
+}
+
+}
+
+LiteralInfo LiteralInfo::any() {
+    return LiteralInfo();
+}
+
+LiteralInfo LiteralInfo::empty_string() {
+    LiteralInfo info;
+    info.exact = std::vector<std::string>{""};
+    return info;
+}
+
+LiteralInfo LiteralInfo::bytes(const ByteSet& bytes) {
+
+    if (bytes.count() > max_strings) {
+        return any();
+    }
+
+    LiteralInfo info;
+    info.exact.emplace();
+    for (unsigned c = 0; c < 256; c++) {
+        if (bytes.contains(static_cast<unsigned char>(c))) {
+            info.exact->push_back(std::string(1, static_cast<char>(c)));
+        }
+    }
+
+    return info;
+
+}
+
+LiteralInfo LiteralInfo::concatenate(const std::vector<LiteralInfo>& pieces) {
+
+    // the exact strings of the pieces since the last one that is not exact
+    std::vector<std::string> run{""};
+    bool exact = true;
+    std::vector<std::string> best;
+
+    for (const LiteralInfo& piece : pieces) {
+        if (piece.exact) {
+            if (auto joined = product(run, *piece.exact)) {
+                run = std::move(*joined);
+                continue;
+            }
+            // too many combinations, a new run starts with the piece
+            exact = false;
+            consider(best, std::move(run));
+            run = *piece.exact;
+            continue;
+        }
+
+        exact = false;
+        consider(best, std::move(run));
+        consider(best, piece.required);
+        run = {""};
+    }
+
+    LiteralInfo info;
+    if (exact) {
+        info.exact = std::move(run);
+    }
+    else {
+        consider(best, std::move(run));
+        info.required = std::move(best);
+    }
+
+    return info;
+
+}
+
+LiteralInfo LiteralInfo::alternate(const std::vector<LiteralInfo>& pieces) {
+
+    LiteralInfo info;
+
+    if (std::all_of(pieces.begin(), pieces.end(), [](const LiteralInfo& piece) { return piece.exact.has_value(); })) {
+        std::vector<std::string> strings;
+        for (const LiteralInfo& piece : pieces) {
+            strings.insert(strings.end(), piece.exact->begin(), piece.exact->end());
+        }
+        normalize(strings);
+        if (strings.size() <= max_strings) {
+            info.exact = std::move(strings);
+            return info;
+        }
+    }
+
+    // every match contains a required literal of the alternative it matches
+    for (const LiteralInfo& piece : pieces) {
+        const std::vector<std::string> required = piece.required_literals();
+        if (required.empty()) {
+            return any();
+        }
+        info.required.insert(info.required.end(), required.begin(), required.end());
+    }
+
+    minimize(info.required);
+    if (info.required.size() > max_strings) {
+        return any();
+    }
+
+    return info;
+
+}
+
+LiteralInfo LiteralInfo::star() const {
+    return any();
+}
+
+LiteralInfo LiteralInfo::plus() const {
+
+    // a repetition contains the first match
+    LiteralInfo info;
+    info.required = required_literals();
+
+    return info;
+
+}
+
+LiteralInfo LiteralInfo::optional() const {
+
+    if (!exact) {
+        return any();
+    }
+
+    LiteralInfo info = *this;
+    info.exact->push_back("");
+    normalize(*info.exact);
+    if (info.exact->size() > max_strings) {
+        return any();
+    }
+
+    return info;
+
+}
+
+std::vector<std::string> LiteralInfo::required_literals() const {
+
+    std::vector<std::string> best;
+    consider(best, exact ? *exact : required);
+
+    return best;
+
+}
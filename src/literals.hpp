@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "byte_set.hpp"
+
+// LiteralInfo is what a piece of the regex tells about the literal strings in the text it matches.
+// It is computed bottom-up over the AST, see Expression::extractLiterals.
+//
+// A piece matching only a few strings, e.g. "ab", "a[bc]" or "(foo|bar)", knows all of them exactly.
+// Combining exact pieces keeps them exact while the number of strings stays small. Beyond that, a piece only
+// knows a set of required literals: every text it matches contains at least one of them, e.g. "ERROR" for
+// ".*ERROR.*" or {"foo", "bar"} for "x*(foo|bar)\d+".
+class LiteralInfo final {
+
+    // every string the piece matches, if there are at most max_strings of them
+    std::optional<std::vector<std::string>> exact;
+    // one of which every match contains, empty if nothing is known
+    std::vector<std::string> required;
+
+public:
+    // The most strings of an exact or required set, larger sets are dropped.
+    static constexpr size_t max_strings = 16;
+
+    // A piece that tells nothing, e.g. the dot.
+    [[nodiscard]] static LiteralInfo any();
+
+    // A piece matching just the empty string.
+    [[nodiscard]] static LiteralInfo empty_string();
+
+    // A piece matching a single byte of the set.
+    [[nodiscard]] static LiteralInfo bytes(const ByteSet& bytes);
+
+    // The pieces matched one after another.
+    [[nodiscard]] static LiteralInfo concatenate(const std::vector<LiteralInfo>& pieces);
+
+    // Any one of the pieces.
+    [[nodiscard]] static LiteralInfo alternate(const std::vector<LiteralInfo>& pieces);
+
+    [[nodiscard]] LiteralInfo star() const;
+    [[nodiscard]] LiteralInfo plus() const;
+    [[nodiscard]] LiteralInfo optional() const;
+
+    // The best set of literals one of which every match contains, i.e. the one whose shortest literal is the
+    // longest. Empty if no such set is known.
+    [[nodiscard]] std::vector<std::string> required_literals() const;
+
+};
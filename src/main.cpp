@@ -1,41 +1,371 @@
-#include <fstream>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include "ast.hpp"
+#include "lazy_dfa.hpp"
 #include "lexer.hpp"
+#include "matcher_cache.hpp"
 #include "mimir.hpp"
 #include "mimir_codegen.hpp"
 #include "regexfe.hpp"
+#include "scan.hpp"
 #include "tests.hpp"
+#include "tiered_compiler.hpp"
 
-int main(int argc, char* argv[]) {
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <spawn.h>
+
+extern char** environ;
+#endif
+
+static void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " <regex_pattern> [<path>...] [--dump-mim] [--line-buffered] [--threads <n>]"
+              << " [--matching | --non-matching] [--line-numbers | --byte-offsets] [--count] [--quiet] [--max-count <n>]"
+              << " [--format text|bitmap|indices] [--backend jit|clang] [--cache-dir <dir> | --no-cache]"
+              << " [--opt-level 0|1|2|3] [--march <cpu>] [--mtune <cpu>] [--emit-bitcode]"
+              << " [--engine tiered|dfa|interpreter|compiled]"
+              << std::endl;
+}
+
+// The most threads --threads accepts, far more than any machine has cores.
+static constexpr size_t max_threads = 1024;
+
+// Parses a count given on the command line, which consists of decimal digits only and is at most max.
+// Unlike std::stoul, it rejects a sign, e.g. "-1", which would wrap around to a huge count, and trailing garbage.
+static std::optional<size_t> parse_count(const std::string& text, const size_t max) {
+    if (text.empty() || text.size() > std::numeric_limits<size_t>::digits10) {
+        return std::nullopt;
+    }
+    size_t count = 0;
+    for (const char digit : text) {
+        if (digit < '0' || digit > '9') {
+            return std::nullopt;
+        }
+        count = count * 10 + static_cast<size_t>(digit - '0');
+    }
+    if (count > max) {
+        return std::nullopt;
+    }
+    return count;
+}
+
+// How the regex is executed.
+enum class Engine {
+    // the lazy DFA until the compiled code is ready
+    Tiered,
+    // only the lazy DFA, nothing is compiled
+    Dfa,
+    // only the Pike VM, nothing is compiled
+    Interpreter,
+    // only the compiled code, matching starts once it is ready
+    Compiled
+};
+
+// Starts a process that compiles the regex into the cache and exits, and returns whether it started. It compiles the
+// regex the way this run would, but on no input, and runs detached: in a process group of its own, e.g. out of reach of
+// a Ctrl-C meant for this run, and with its standard streams on /dev/null, so that it outlives this run unnoticed.
+// Only where /proc/self/exe names the running executable, i.e. on Linux.
+static bool spawn_cache_writer(const std::string& pattern, const MimirCodeGen::Backend backend,
+                               const std::filesystem::path& cache_directory, const CodeGenOptions& codegen_options) {
+#ifdef _WIN32
+    return false;
+#else
+    std::vector<std::string> args = {
+        "regexfe", "--engine", "compiled", "--quiet",
+        "--backend", backend == MimirCodeGen::Backend::Jit ? "jit" : "clang",
+        "--cache-dir", cache_directory.string(),
+        "--opt-level", std::to_string(codegen_options.opt_level),
+    };
+    if (!codegen_options.march.empty()) {
+        args.insert(args.end(), {"--march", codegen_options.march});
+    }
+    if (!codegen_options.mtune.empty()) {
+        args.insert(args.end(), {"--mtune", codegen_options.mtune});
+    }
+    if (codegen_options.bitcode) {
+        args.emplace_back("--emit-bitcode");
+    }
+    args.insert(args.end(), {"--", pattern, "/dev/null"});
 
-    if (argc < 3) {
-        if (argc == 2) {
-            if (std::string first_arg = argv[1]; first_arg == "--run-tests") {
-                return run_tests();
+    std::vector<char*> argv;
+    for (std::string& arg : args) {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    for (const int fd : {0, 1, 2}) {
+        posix_spawn_file_actions_addopen(&actions, fd, "/dev/null", fd == 0 ? O_RDONLY : O_WRONLY, 0);
+    }
+
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attributes, 0);
+
+    pid_t pid = 0;
+    const int spawned = posix_spawn(&pid, "/proc/self/exe", &actions, &attributes, argv.data(), environ);
+
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+
+    return spawned == 0;
+#endif
+}
+
+// Scans the files and returns the exit status.
+static int scan_files(const Matcher& matcher, const Prefilter* prefilter, const std::vector<std::string>& file_names,
+                      const ScanOptions& options, const size_t threads, const bool line_buffered) {
+
+#ifdef _WIN32
+    // binary frames must not have their '\n' bytes translated
+    if (options.format != OutputFormat::Text) {
+        _setmode(OutputWriter::stdout_fd, _O_BINARY);
+    }
+#endif
+
+    OutputWriter output(OutputWriter::stdout_fd, line_buffered);
+    Scanner scanner(matcher, output, options, prefilter);
+
+    try {
+        if (threads == 1) {
+            for (const std::string& file_name : file_names) {
+                scanner.scan(file_name);
+            }
+        }
+        else {
+            ThreadPool pool(threads);
+            for (const std::string& file_name : file_names) {
+                scanner.scan(file_name, pool);
             }
+            pool.wait_idle();
         }
-        std::cerr << "Usage: " << argv[0] << " <regex_pattern> <file_name> [--dump-mim]" << std::endl;
+        output.flush();
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    // like grep, a selected line takes precedence over read errors in quiet mode
+    if (scanner.had_errors() && !(options.quiet && scanner.found_any())) {
         return 2;
     }
 
-    std::string regex_pattern = argv[1];
-    std::string file_name = argv[2];
+    // unless every line is reported, the exit status tells whether any line was selected
+    const bool selective = options.selection != Selection::All || options.count || options.quiet;
+    if (selective && !scanner.found_any()) {
+        return 1;
+    }
+
+    return 0;
+
+}
+
+int main(int argc, char* argv[]) {
+
+    if (argc == 2) {
+        if (std::string first_arg = argv[1]; first_arg == "--run-tests") {
+            return run_tests();
+        }
+    }
 
+    std::vector<std::string> positional_args;
     bool dump_mim = false;
-    if (argc == 4) {
-        if (std::string flag = argv[3]; flag == "--dump-mim") {
+    bool line_buffered = false;
+    // 1 means sequential, 0 means one thread per core
+    size_t threads = 1;
+    ScanOptions options;
+    auto backend = MimirCodeGen::has_jit() ? MimirCodeGen::Backend::Jit : MimirCodeGen::Backend::Clang;
+    std::optional<std::filesystem::path> cache_directory = MatcherCache::default_directory();
+    CodeGenOptions codegen_options;
+    Engine engine = Engine::Tiered;
+
+    for (int i = 1; i < argc; i++) {
+
+        std::string arg = argv[i];
+
+        // everything after "--" is positional, e.g. a pattern starting with "--"
+        if (arg == "--") {
+            positional_args.insert(positional_args.end(), argv + i + 1, argv + argc);
+            break;
+        }
+
+        if (arg == "--dump-mim") {
             dump_mim = true;
         }
-        else {
-            std::cerr << "Unknown option: " << flag << "\n";
+        else if (arg == "--line-buffered") {
+            line_buffered = true;
+        }
+        else if (arg == "--threads") {
+            if (i + 1 == argc) {
+                std::cerr << "Missing value for option: " << arg << "\n";
+                return 2;
+            }
+            if (const auto count = parse_count(argv[++i], max_threads)) {
+                threads = *count;
+            }
+            else {
+                std::cerr << "Invalid number of threads: " << argv[i] << " (expected 0 to " << max_threads << ")\n";
+                return 2;
+            }
+        }
+        else if (arg == "--matching") {
+            options.selection = Selection::Matching;
+        }
+        else if (arg == "--non-matching") {
+            options.selection = Selection::NonMatching;
+        }
+        else if (arg == "--line-numbers") {
+            options.label = LineLabel::Number;
+        }
+        else if (arg == "--byte-offsets") {
+            options.label = LineLabel::ByteOffset;
+        }
+        else if (arg == "--count") {
+            options.count = true;
+        }
+        else if (arg == "--quiet") {
+            options.quiet = true;
+        }
+        else if (arg == "--max-count") {
+            if (i + 1 == argc) {
+                std::cerr << "Missing value for option: " << arg << "\n";
+                return 2;
+            }
+            if (const auto count = parse_count(argv[++i], std::numeric_limits<size_t>::max())) {
+                options.max_count = *count;
+            }
+            else {
+                std::cerr << "Invalid maximum count: " << argv[i] << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--format") {
+            if (i + 1 == argc) {
+                std::cerr << "Missing value for option: " << arg << "\n";
+                return 2;
+            }
+            if (const std::string format = argv[++i]; format == "text") {
+                options.format = OutputFormat::Text;
+            }
+            else if (format == "bitmap") {
+                options.format = OutputFormat::Bitmap;
+            }
+            else if (format == "indices") {
+                options.format = OutputFormat::Indices;
+            }
+            else {
+                std::cerr << "Invalid output format: " << format << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--backend") {
+            if (i + 1 == argc) {
+                std::cerr << "Missing value for option: " << arg << "\n";
+                return 2;
+            }
+            if (const std::string name = argv[++i]; name == "jit" && MimirCodeGen::has_jit()) {
+                backend = MimirCodeGen::Backend::Jit;
+            }
+            else if (name == "clang") {
+                backend = MimirCodeGen::Backend::Clang;
+            }
+            else {
+                std::cerr << "Unavailable backend: " << name << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--cache-dir") {
+            if (i + 1 == argc) {
+                std::cerr << "Missing value for option: " << arg << "\n";
+                return 2;
+            }
+            cache_directory = argv[++i];
+        }
+        else if (arg == "--no-cache") {
+            cache_directory.reset();
+        }
+        else if (arg == "--opt-level") {
+            if (i + 1 == argc) {
+                std::cerr << "Missing value for option: " << arg << "\n";
+                return 2;
+            }
+            if (const std::string level = argv[++i]; level.size() == 1 && level[0] >= '0' && level[0] <= '3') {
+                codegen_options.opt_level = level[0] - '0';
+            }
+            else {
+                std::cerr << "Invalid optimization level: " << level << "\n";
+                return 2;
+            }
+        }
+        else if (arg == "--march" || arg == "--mtune") {
+            if (i + 1 == argc) {
+                std::cerr << "Missing value for option: " << arg << "\n";
+                return 2;
+            }
+            (arg == "--march" ? codegen_options.march : codegen_options.mtune) = argv[++i];
+        }
+        else if (arg == "--emit-bitcode") {
+            codegen_options.bitcode = true;
+        }
+        else if (arg == "--engine") {
+            if (i + 1 == argc) {
+                std::cerr << "Missing value for option: " << arg << "\n";
+                return 2;
+            }
+            if (const std::string name = argv[++i]; name == "tiered") {
+                engine = Engine::Tiered;
+            }
+            else if (name == "dfa") {
+                engine = Engine::Dfa;
+            }
+            else if (name == "interpreter") {
+                engine = Engine::Interpreter;
+            }
+            else if (name == "compiled") {
+                engine = Engine::Compiled;
+            }
+            else {
+                std::cerr << "Unknown engine: " << name << "\n";
+                return 2;
+            }
+        }
+        else if (arg.starts_with("--")) {
+            std::cerr << "Unknown option: " << arg << "\n";
             return 2;
         }
+        else {
+            positional_args.push_back(std::move(arg));
+        }
+    }
+
+    if (positional_args.empty()) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    const std::string& regex_pattern = positional_args[0];
+    std::vector<std::string> paths(positional_args.begin() + 1, positional_args.end());
+
+    // without paths, the standard input is read
+    if (paths.empty()) {
+        paths.emplace_back("-");
     }
 
     // parse regular expression
-    Expression* expression;
+    std::shared_ptr<const Expression> expression;
     try {
         expression = parse_regex(regex_pattern);
     }
@@ -48,31 +378,95 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    MimirCodeGen code_gen;
-    MimRegex regex = expression->generateMimIR(code_gen);
+    try {
+        codegen_options.validate();
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    const auto configure = [&](MimirCodeGen& code_gen) {
+        code_gen.set_backend(backend);
+        code_gen.set_codegen_options(codegen_options);
 
-    delete expression;
+        // without a usable cache directory, every run compiles the regex
+        if (cache_directory) {
+            try {
+                code_gen.set_cache(std::make_shared<MatcherCache>(*cache_directory));
+            }
+            catch (const std::runtime_error&) {}
+        }
+    };
 
     if (dump_mim) {
-        std::cout << regex << std::endl;
+        MimirCodeGen code_gen;
+        configure(code_gen);
+        std::cout << expression->generateMimIR(code_gen) << std::endl;
         return 0;
     }
 
-    std::ifstream input_file(file_name);
-    if (!input_file.is_open()) {
-        std::cerr << "0: error: could not open file '" << file_name << "' for reading." << std::endl;
-        return 2;
+    const std::vector<std::string> file_names = expand_paths(paths);
+    // the file name is part of the result as soon as there can be more than one file
+    options.print_file_names = paths.size() > 1 || file_names.size() != 1 || file_names[0] != paths[0];
+
+    // lines that cannot match, as their length, first or last byte is wrong or they lack every literal the
+    // regex requires, are rejected before they reach the matcher
+    const std::shared_ptr<const Prefilter> prefilter = Prefilter::make(
+        expression->lengthBounds(), expression->edgeBytes(), expression->extractLiterals().required_literals());
+
+    if (engine == Engine::Dfa) {
+        const Matcher matcher(std::make_shared<LazyDfa>(expression->generatePikeProgram()));
+        return scan_files(matcher, prefilter.get(), file_names, options, threads, line_buffered);
+    }
+
+    if (engine == Engine::Interpreter) {
+        const Matcher matcher(std::make_shared<PikeProgram>(expression->generatePikeProgram()));
+        return scan_files(matcher, prefilter.get(), file_names, options, threads, line_buffered);
+    }
+
+    // trivial shapes are matched by built-in kernels, which need neither MimIR nor a compiler
+    if (engine == Engine::Tiered || engine == Engine::Compiled) {
+        if (const std::optional<std::vector<ShapePiece>> shape = expression->shape()) {
+            if (std::shared_ptr<const FastPath> fast_path = FastPath::classify(*shape)) {
+                const Matcher matcher(std::move(fast_path));
+                return scan_files(matcher, prefilter.get(), file_names, options, threads, line_buffered);
+            }
+        }
+    }
+
+    if (engine == Engine::Compiled) {
+        // unlike the tiered engine, which stays on the lazy DFA, there is nothing to match with if compiling fails
+        std::optional<Matcher> matcher;
+        try {
+            MimirCodeGen code_gen;
+            configure(code_gen);
+            matcher.emplace(code_gen.make_matcher(expression->generateMatcherSource(code_gen)));
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+            return 2;
+        }
+        return scan_files(*matcher, prefilter.get(), file_names, options, threads, line_buffered);
     }
 
-    std::function<bool(const char*)> matcher = code_gen.make_matcher(regex);
+    TieredCompiler compiler(expression, configure);
+    const int status = scan_files(compiler.matcher(), prefilter.get(), file_names, options, threads, line_buffered);
 
-    std::string line;
-    while (std::getline(input_file, line)) {
-        bool matched = matcher(line.c_str());
-        std::cout << line << "," << (matched ? "true" : "false") << std::endl;
+    if (compiler.finished()) {
+        return status;
     }
 
-    input_file.close();
+    // A short run is over before the regex is compiled. With a cache, a detached process compiles the regex into it,
+    // so that the next run starts on the compiled code. If that process cannot be started, this run finishes the
+    // compilation before it exits instead, which destroying the compiler waits for.
+    if (cache_directory && !spawn_cache_writer(regex_pattern, backend, *cache_directory, codegen_options)) {
+        return status;
+    }
 
-    return 0;
+    // The compilation of this run is stopped, which leaves no compiler process or file behind, and the run exits
+    // without waiting for the background thread, which may be compiling in the JIT, where it cannot be interrupted.
+    // The results have been written and flushed by scan_files already.
+    compiler.cancel();
+    std::quick_exit(status);
 }
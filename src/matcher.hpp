@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+// A subject of a batch match, see Matcher::match_batch.
+struct MatchSpan {
+    const char* begin;
+    size_t length;
+};
+
+// MatchEngine matches a regex without compiled code, e.g. by interpreting it.
+// It must be safe to call from several threads at once.
+class MatchEngine {
+
+public:
+    virtual ~MatchEngine() = default;
+
+    // Whether the whole span matches the regex.
+    [[nodiscard]] virtual bool matches(const char* begin, size_t length) const = 0;
+
+    // Sets bit i % 64 of results[i / 64] if spans[i] matches. The results are zero on entry.
+    // Engines that can advance several spans at once override this.
+    virtual void match_batch(const MatchSpan* spans, const size_t count, uint64_t* results) const {
+        for (size_t i = 0; i < count; i++) {
+            results[i / 64] |= static_cast<uint64_t>(matches(spans[i].begin, spans[i].length)) << (i % 64);
+        }
+    }
+
+};
+
+// Matcher is a handle to the entry points compiled for a single regex.
+// It can be called either on a NUL-terminated string or on a span (begin, length).
+//
+// The span form reads exactly the bytes [begin, begin + length), so the span may be part of a larger
+// buffer and may contain NUL bytes, which match like any other byte, e.g. "." matches "\0". It gives the
+// same result on every engine and on compiled code. The C-string form ends the subject at its first NUL byte.
+//
+// A Matcher keeps the code it calls alive. Copies share that code, which is freed with the last copy,
+// independently of other matchers and of the MimirCodeGen that compiled it.
+//
+// A Matcher can also start out on a MatchEngine and be promoted to compiled code later, while it is in use.
+// The promotion applies to all copies at once.
+class Matcher final {
+
+public:
+    using CStringFunction = bool (*)(const char*);
+    using SpanFunction = bool (*)(const char*, size_t);
+
+private:
+    // The state shared by the copies of a matcher that starts out on a MatchEngine.
+    struct Tiers {
+        std::shared_ptr<const MatchEngine> engine;
+        // null until promoted, published with release ordering after code is set
+        std::atomic<CStringFunction> c_string_function = nullptr;
+        std::atomic<SpanFunction> span_function = nullptr;
+        std::shared_ptr<const void> code;
+    };
+
+    CStringFunction c_string_function = nullptr;
+    SpanFunction span_function = nullptr;
+    std::shared_ptr<const void> code;
+    std::shared_ptr<Tiers> tiers;
+
+public:
+    // The code, e.g. a loaded shared library, must contain both functions and is released when the
+    // last copy of the matcher is destroyed.
+    explicit Matcher(const CStringFunction c_string_function, const SpanFunction span_function,
+                     std::shared_ptr<const void> code = nullptr)
+        : c_string_function(c_string_function), span_function(span_function), code(std::move(code)) {}
+
+    // Matches with the engine until promote is called on this matcher or on one of its copies.
+    explicit Matcher(std::shared_ptr<const MatchEngine> engine) : tiers(std::make_shared<Tiers>()) {
+        tiers->engine = std::move(engine);
+    }
+
+    // Switches a matcher made from a MatchEngine, and all of its copies, to the code of the compiled matcher.
+    // Calls running concurrently finish on the engine. Must be called at most once.
+    void promote(const Matcher& compiled) const {
+        assert(tiers != nullptr && compiled.tiers == nullptr && !promoted());
+        tiers->code = compiled.code;
+        tiers->c_string_function.store(compiled.c_string_function, std::memory_order_release);
+        tiers->span_function.store(compiled.span_function, std::memory_order_release);
+    }
+
+    // Whether the matcher runs compiled code, i.e. it was compiled or has been promoted.
+    [[nodiscard]] bool promoted() const {
+        return tiers == nullptr || tiers->span_function.load(std::memory_order_acquire) != nullptr;
+    }
+
+    bool operator()(const char* str) const {
+        if (tiers == nullptr) [[likely]] {
+            return c_string_function(str);
+        }
+        if (const CStringFunction function = tiers->c_string_function.load(std::memory_order_acquire)) {
+            return function(str);
+        }
+        return tiers->engine->matches(str, std::strlen(str));
+    }
+
+    bool operator()(const char* begin, const size_t length) const {
+        if (tiers == nullptr) [[likely]] {
+            return span_function(begin, length);
+        }
+        if (const SpanFunction function = tiers->span_function.load(std::memory_order_acquire)) {
+            return function(begin, length);
+        }
+        return tiers->engine->matches(begin, length);
+    }
+
+    // Matches all spans with one call, which decides once which code runs them, and sets bit i % 64 of
+    // results[i / 64] if spans[i] matches, clearing the other bits. results must hold (count + 63) / 64 words.
+    //
+    // Only an engine walks the spans in lockstep, e.g. the LazyDfa, which hides the latency of one span's
+    // transitions behind those of the others. Compiled code is called once per span, one span after another:
+    // MimirCodeGen generates no batch entry point, so the compiled tier of a batch saves only the dispatch.
+    void match_batch(const MatchSpan* spans, const size_t count, uint64_t* results) const {
+
+        std::fill(results, results + (count + 63) / 64, 0);
+
+        const SpanFunction function =
+            tiers == nullptr ? span_function : tiers->span_function.load(std::memory_order_acquire);
+
+        if (function == nullptr) {
+            tiers->engine->match_batch(spans, count, results);
+            return;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            results[i / 64] |= static_cast<uint64_t>(function(spans[i].begin, spans[i].length)) << (i % 64);
+        }
+
+    }
+
+};
@@ -0,0 +1,217 @@
+#include "matcher_cache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// temporary files start with this prefix, they are never taken for entries
+static constexpr std::string_view temporary_prefix = ".tmp-";
+
+// temporary files older than this have been left behind by a process that died while writing them
+static constexpr auto stale_age = std::chrono::hours(1);
+
+MatcherCache::MatcherCache(fs::path directory, const uintmax_t max_size)
+    : directory(std::move(directory)), max_size(max_size) {
+
+    std::error_code error;
+    fs::create_directories(this->directory, error);
+
+    if (error || !fs::is_directory(this->directory, error)) {
+        throw std::runtime_error("0: error: could not create cache directory '" + this->directory.string() + "'.");
+    }
+
+}
+
+std::optional<fs::path> MatcherCache::default_directory() {
+
+    if (const char* directory = std::getenv("REGEXFE_CACHE_DIR"); directory != nullptr && *directory != '\0') {
+        return fs::path(directory);
+    }
+
+#ifdef _WIN32
+    if (const char* local = std::getenv("LOCALAPPDATA"); local != nullptr && *local != '\0') {
+        return fs::path(local) / "regexfe";
+    }
+#else
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg != nullptr && *xdg != '\0') {
+        return fs::path(xdg) / "regexfe";
+    }
+
+    if (const char* home = std::getenv("HOME"); home != nullptr && *home != '\0') {
+        return fs::path(home) / ".cache" / "regexfe";
+    }
+#endif
+
+    return std::nullopt;
+
+}
+
+std::string MatcherCache::make_key(const std::initializer_list<std::string_view> parts) {
+
+    // two independent 64-bit FNV-1a hashes, making accidental collisions practically impossible
+    uint64_t first = 14695981039346656037ULL;
+    uint64_t second = 14695981039346656037ULL ^ 0x5bd1e995ULL;
+
+    const auto feed = [&](const unsigned char byte) {
+        first = (first ^ byte) * 1099511628211ULL;
+        second = (second ^ byte) * 1099511628211ULL;
+        second ^= second >> 29;
+    };
+
+    for (const std::string_view part : parts) {
+        // the length separates the parts
+        for (size_t length = part.size(), i = 0; i < 8; i++, length >>= 8) {
+            feed(static_cast<unsigned char>(length));
+        }
+        for (const char c : part) {
+            feed(static_cast<unsigned char>(c));
+        }
+    }
+
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string key;
+
+    for (const uint64_t hash : {first, second}) {
+        for (int shift = 60; shift >= 0; shift -= 4) {
+            key.push_back(digits[(hash >> shift) & 0xf]);
+        }
+    }
+
+    return key;
+
+}
+
+std::optional<fs::path> MatcherCache::find(const std::string& key, const std::string_view extension) const {
+
+    fs::path entry = directory / (key + std::string(extension));
+    std::error_code error;
+
+    if (!fs::is_regular_file(entry, error)) {
+        return std::nullopt;
+    }
+
+    // failing to update the time only makes the entry more likely to be evicted
+    fs::last_write_time(entry, fs::file_time_type::clock::now(), error);
+
+    return entry;
+
+}
+
+fs::path MatcherCache::temporary_path(const std::string& key, const std::string_view extension) const {
+
+    // unique among the processes sharing the cache, and among the calls in this process
+    static std::atomic<uint64_t> counter = 0;
+    static const uint64_t process_tag = std::random_device()() ^ (uint64_t{std::random_device()()} << 32);
+
+    return directory / (std::string(temporary_prefix) + key + "-" + std::to_string(process_tag) + "-" +
+                        std::to_string(counter.fetch_add(1)) + std::string(extension));
+
+}
+
+fs::path MatcherCache::publish(const fs::path& temporary, const std::string& key, const std::string_view extension) {
+
+    fs::path entry = directory / (key + std::string(extension));
+    std::error_code error;
+
+    fs::rename(temporary, entry, error);
+
+    // renaming over an existing file may fail on some systems, the existing entry is as good as ours
+    if (error) {
+        if (!fs::is_regular_file(entry, error)) {
+            throw std::runtime_error("0: error: could not store cache entry '" + entry.string() + "'.");
+        }
+        fs::remove(temporary, error);
+    }
+
+    evict(entry);
+
+    return entry;
+
+}
+
+fs::path MatcherCache::insert(const std::string& key, const std::string_view extension, const std::string_view contents) {
+
+    const fs::path temporary = temporary_path(key, extension);
+
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        if (!file.flush()) {
+            std::error_code error;
+            fs::remove(temporary, error);
+            throw std::runtime_error("0: error: could not write cache entry '" + temporary.string() + "'.");
+        }
+    }
+
+    return publish(temporary, key, extension);
+
+}
+
+void MatcherCache::evict(const fs::path& keep) const {
+
+    struct Entry {
+        fs::path path;
+        uintmax_t size;
+        fs::file_time_type last_use;
+    };
+
+    std::vector<Entry> entries;
+    uintmax_t total_size = 0;
+    const auto now = fs::file_time_type::clock::now();
+    std::error_code error;
+
+    for (auto it = fs::directory_iterator(directory, error); !error && it != fs::directory_iterator();
+         it.increment(error)) {
+
+        std::error_code entry_error;
+
+        if (!it->is_regular_file(entry_error)) {
+            continue;
+        }
+
+        const uintmax_t size = it->file_size(entry_error);
+        if (entry_error) {
+            continue;
+        }
+
+        const fs::file_time_type last_use = it->last_write_time(entry_error);
+        if (entry_error) {
+            continue;
+        }
+
+        if (it->path().filename().string().starts_with(temporary_prefix)) {
+            if (now - last_use > stale_age) {
+                fs::remove(it->path(), entry_error);
+            }
+            continue;
+        }
+
+        entries.push_back(Entry{it->path(), size, last_use});
+        total_size += size;
+    }
+
+    if (total_size <= max_size) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.last_use < b.last_use; });
+
+    // entries removed by another process at the same time count as removed, too
+    for (const Entry& entry : entries) {
+        if (total_size <= max_size) {
+            break;
+        }
+        if (entry.path != keep) {
+            fs::remove(entry.path, error);
+            total_size -= entry.size;
+        }
+    }
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// MatcherCache keeps compiled matchers on disk, so that a regex compiled by an earlier run is loaded
+// instead of being compiled again.
+//
+// Every entry is a file named after a hash of everything its code depends on, i.e. the MimIR of the regex,
+// the compiler and the code generation flags, thus entries never need to be invalidated. New entries are written
+// to a temporary file in the cache directory and then renamed to their final name. The rename is atomic,
+// so several processes can populate the same cache concurrently and only ever see complete entries.
+//
+// Once the entries exceed the size limit, the least recently used ones are removed. Using an entry updates
+// its modification time, which serves as the time of last use.
+class MatcherCache final {
+
+    std::filesystem::path directory;
+    uintmax_t max_size;
+
+    void evict(const std::filesystem::path& keep) const;
+
+public:
+    static constexpr uintmax_t default_max_size = uintmax_t{256} << 20;
+
+    // Creates the directory if it does not exist yet. Throws std::runtime_error if that is not possible.
+    explicit MatcherCache(std::filesystem::path directory, uintmax_t max_size = default_max_size);
+
+    // $REGEXFE_CACHE_DIR if set, otherwise "regexfe" in the user's cache directory, i.e. $XDG_CACHE_HOME,
+    // $HOME/.cache or %LOCALAPPDATA%. Empty if none of them is set.
+    [[nodiscard]] static std::optional<std::filesystem::path> default_directory();
+
+    // Hashes the parts into a key. Different sequences of parts give different keys, e.g. {"ab", "c"} and {"a", "bc"}.
+    [[nodiscard]] static std::string make_key(std::initializer_list<std::string_view> parts);
+
+    // Returns the path of the entry, if it exists, and marks the entry as recently used.
+    [[nodiscard]] std::optional<std::filesystem::path> find(const std::string& key, std::string_view extension) const;
+
+    // Returns a path in the cache directory that no other thread or process uses, to write a new entry to.
+    [[nodiscard]] std::filesystem::path temporary_path(const std::string& key, std::string_view extension) const;
+
+    // Turns the temporary file into the entry and returns the path of the entry.
+    // If another process has published the same entry in the meantime, either file may be kept, as both are equal.
+    // Throws std::runtime_error if the entry cannot be published, the temporary file is left alone then.
+    std::filesystem::path publish(const std::filesystem::path& temporary, const std::string& key,
+                                  std::string_view extension);
+
+    // Writes the contents to a new entry and returns its path, like publish.
+    std::filesystem::path insert(const std::string& key, std::string_view extension, std::string_view contents);
+
+};
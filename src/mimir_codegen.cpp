@@ -12,20 +12,193 @@
 #include <mim/util/dl.h>
 #include <mim/util/sys.h>
 
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
 #include <stdexcept>
-#include <thread>
+#include <string_view>
+#include <unordered_set>
 
+#include "dfa_table.hpp"
+#include "jit.hpp"
+#include "lazy_dfa.hpp"
+#include "matcher_cache.hpp"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+extern char** environ;
+#endif
+
+// Flags passed to clang by compile_to_shared, besides those of the
+// CodeGenOptions.
+static constexpr const char* CLANG_FLAGS = "-Wno-override-module -shared";
+
+// The most ranges of bytes the span function of a regex tests in all of its
+// states, each of which becomes a branch. The matchers of regexes whose DFA
+// has more run on a LazyDfa, see make_matcher.
+static constexpr size_t MAX_SPAN_RANGES = size_t{1} << 14;
+
+// Identifies the build in the keys of cached matchers: the commit regexfe is
+// built from and the version of MimIR. Both are set by CMake. A build from
+// uncommitted changes keeps the commit, which is why the keys hash the
+// generated IR as well, see canonical_ir.
+#ifndef REGEXFE_GIT_HASH
+#define REGEXFE_GIT_HASH "unknown"
+#endif
+#ifndef REGEXFE_MIM_VERSION
+#define REGEXFE_MIM_VERSION "unknown"
+#endif
+static constexpr const char* BUILD_ID =
+    "regexfe " REGEXFE_GIT_HASH " mim " REGEXFE_MIM_VERSION;
+
+// Identify the clang run by compile_to_shared by its path, size and time of
+// modification, which change whenever it is updated. This is much cheaper
+// than running clang --version.
+static std::string clang_identity() {
+#ifdef _WIN32
+    constexpr char separator = ';';
+    constexpr const char* name = "clang.exe";
+#else
+    constexpr char separator = ':';
+    constexpr const char* name = "clang";
+#endif
+    const char* path = std::getenv("PATH");
+    std::string_view directories = path != nullptr ? path : "";
+
+    while (!directories.empty()) {
+        auto end = directories.find(separator);
+        auto candidate =
+            std::filesystem::path(directories.substr(0, end)) / name;
+
+        std::error_code error;
+        if (std::filesystem::is_regular_file(candidate, error)) {
+            auto size = std::filesystem::file_size(candidate, error);
+            auto time = std::filesystem::last_write_time(candidate, error);
+            return mim::fmt("{} {} {}", candidate.string(), size,
+                            time.time_since_epoch().count());
+        }
+
+        if (end == std::string_view::npos) break;
+        directories.remove_prefix(end + 1);
+    }
+
+    return name;
+}
+
+// Identify the CPU of this machine, which -march=native and -mtune=native
+// compile for, with its features. Without LLVM, it is read from
+// /proc/cpuinfo, where that exists.
+static std::string host_cpu_identity() {
+#ifdef REGEXFE_HAVE_LLVM_JIT
+    return JitCompiler::target_identity();
+#else
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string identity;
+    std::string line;
+    // the first processor, which is like the others
+    while (std::getline(cpuinfo, line) && !(line.empty() && !identity.empty())) {
+        for (const char* field : {"vendor_id", "model", "flags", "CPU ", "Features"})
+            if (line.starts_with(field)) identity += line + "\n";
+    }
+    return identity;
+#endif
+}
+
+// Whether the options compile for the CPU of this machine.
+static bool targets_host(const CodeGenOptions& options) {
+    return options.march == "native" || options.mtune == "native";
+}
+
+// The IR with every local and global name replaced by the number of its
+// first appearance. MimIR numbers the names it generates by a counter of its
+// world, so the same code is named differently in another run or after other
+// regexes, but has the same canonical IR.
+static std::string canonical_ir(const std::string& ir) {
+    const auto is_name_char = [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' ||
+               c == '.' || c == '$' || c == '-';
+    };
+
+    std::string canonical;
+    canonical.reserve(ir.size());
+    std::unordered_map<std::string_view, size_t> numbers;
+    for (size_t i = 0; i < ir.size();) {
+        if ((ir[i] == '%' || ir[i] == '@') && i + 1 < ir.size() &&
+            is_name_char(ir[i + 1])) {
+            auto end = i + 1;
+            while (end < ir.size() && is_name_char(ir[end])) ++end;
+            auto name = std::string_view(ir).substr(i, end - i);
+            auto [number, added] = numbers.emplace(name, numbers.size());
+            canonical += ir[i];
+            canonical += std::to_string(number->second);
+            i = end;
+        } else {
+            canonical += ir[i++];
+        }
+    }
+    return canonical;
+}
+
+// The name of a generated function of the regex with the given id.
+static std::string symbol_name(const char* function, const std::string& id) {
+    return mim::fmt("{}_{}", function, id);
+}
+
+// A path in the temporary directory for the shared library of the regex with
+// the given id. It differs between processes and between calls, thus
+// concurrent compilations never overwrite each other's files.
+static std::filesystem::path temporary_library_path(const std::string& id) {
 #ifdef _WIN32
-#define WEXITSTATUS
+    static const auto process = _getpid();
+#else
+    static const auto process = getpid();
 #endif
+    static std::atomic<uint64_t> counter = 0;
+    return std::filesystem::temp_directory_path() /
+           mim::fmt("regexfe-{}-{}-{}.{}", id, process, counter.fetch_add(1),
+                    mim::dl::extension);
+}
 
 MimirCodeGen::MimirCodeGen()
-    : driver_(), world_(driver_.world()), jit_lib_(nullptr, mim::dl::close) {
+    : driver_(),
+      world_(driver_.world()),
+      backend_(has_jit() ? Backend::Jit : Backend::Clang) {
     world_.log().set(&std::cerr);
     mim::ast::load_plugins(
         world_, {"compile", "mem", "core", "opt", "regex", "direct"});
 }
 
+MimirCodeGen::~MimirCodeGen() = default;
+
+void MimirCodeGen::set_backend(Backend backend) { backend_ = backend; }
+
+void MimirCodeGen::set_codegen_options(CodeGenOptions options) {
+    options.validate();
+    options_ = std::move(options);
+}
+
+void MimirCodeGen::set_cache(std::shared_ptr<MatcherCache> cache) {
+    cache_ = std::move(cache);
+}
+
+bool MimirCodeGen::has_jit() {
+#ifdef REGEXFE_HAVE_LLVM_JIT
+    return true;
+#else
+    return false;
+#endif
+}
+
 void MimirCodeGen::set_log_level(mim::Log::Level level) {
     world_.log().set(level);
 }
@@ -39,14 +212,14 @@ void MimirCodeGen::set_log_level(mim::Log::Level level) {
     exit (final_mem, %core.bit2.and_ 0 (matched, %core.icmp.e (last_elem, 0:I8)));
 */
 // clang-format on
-void MimirCodeGen::mim_match(const mim::Def* re) {
+void MimirCodeGen::mim_match(const mim::Def* re, const std::string& name) {
     auto match = world_
                      .mut_con({world_.annex<mim::plug::mem::M>(),
                                world_.call<mim::plug::mem::Ptr0>(world_.arr(
                                    world_.top_nat(), world_.type_i8())),
                                world_.cn({world_.annex<mim::plug::mem::M>(),
                                           world_.type_bool()})})
-                     ->set(MATCHER_FUNC_NAME);
+                     ->set(name);
     match->make_external();
     auto [mem, to_match, exit] = match->vars<3>();
 
@@ -70,11 +243,174 @@ void MimirCodeGen::mim_match(const mim::Def* re) {
     match->app(false, exit, {final_mem, matched_and_end});
 }
 
-int MimirCodeGen::compile_to_shared(std::string out) {
-    auto ll = out + ".ll";
-    {
-        std::ofstream ofs(ll);
-        driver_.backend("ll")(world_, ofs);
+namespace {
+// Bytes from first to last lead to the state target.
+struct ByteRange {
+    uint8_t first;
+    uint8_t last;
+    uint32_t target;
+};
+}  // namespace
+
+struct MimirCodeGen::SpanAutomaton {
+    uint32_t start;
+    // the accepting states come first, see DfaTable
+    uint32_t accepting;
+    // by state, without the bytes leading to the dead state
+    std::vector<std::vector<ByteRange>> ranges;
+};
+
+// The automaton the span function of the regex is generated from, or nothing
+// if its DFA is too large.
+std::optional<MimirCodeGen::SpanAutomaton> MimirCodeGen::span_automaton(
+    const PikeProgram& program) {
+    std::optional<DfaTable> dfa;
+    try {
+        dfa.emplace(program);
+    } catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+
+    SpanAutomaton automaton{dfa->start_state(), dfa->accepting_states(), {}};
+    automaton.ranges.resize(dfa->states());
+    size_t count = 0;
+    for (uint32_t state = 0; state < dfa->states(); ++state) {
+        auto& ranges = automaton.ranges[state];
+        for (unsigned byte = 0; byte < 256; ++byte) {
+            auto target = dfa->next(state, static_cast<uint8_t>(byte));
+            if (!ranges.empty() && ranges.back().target == target &&
+                ranges.back().last + 1u == byte)
+                ranges.back().last = static_cast<uint8_t>(byte);
+            else if (target != DfaTable::dead)
+                ranges.push_back({static_cast<uint8_t>(byte),
+                                  static_cast<uint8_t>(byte), target});
+        }
+        count += ranges.size();
+        if (count > MAX_SPAN_RANGES) return std::nullopt;
+    }
+    return automaton;
+}
+
+// clang-format off
+/*
+.con .extern match_span[mem: %mem.M, begin: %mem.Ptr («⊤:.Nat; .Idx 256», 0), length: .Idx Top, exit : .Cn [%mem.M, .Idx 2]] =
+    state_<start> (mem, 0:(.Idx Top));
+
+for every state s, which the DFA is in before the byte at pos:
+.con state_s[mem: %mem.M, pos: .Idx Top] =
+    .con end[m: %mem.M] = exit (m, <s is accepting>);
+    .con step[m: %mem.M] =
+        .let (load_mem, byte) = %mem.load (m, %mem.lea (Top, <Top; .Idx 256>, 0) (begin, pos));
+        .let next = %core.wrap.add %core.mode.nuw (pos, 1:(.Idx Top));
+        <branch on the ranges of s one after another, to state_<target> (load_mem, next)
+         for the first containing the byte, and to exit (load_mem, ff) after the last>;
+    (step, end)#(%core.icmp.e (pos, length)) mem;
+*/
+// clang-format on
+void MimirCodeGen::mim_match_span(const SpanAutomaton& automaton,
+                                  const std::string& name) {
+    auto mem_type = world_.annex<mim::plug::mem::M>();
+    auto index_type = world_.type_idx(world_.top_nat());
+    auto match =
+        world_
+            .mut_con({mem_type,
+                      world_.call<mim::plug::mem::Ptr0>(
+                          world_.arr(world_.top_nat(), world_.type_i8())),
+                      index_type, world_.cn({mem_type, world_.type_bool()})})
+            ->set(name);
+    match->make_external();
+    auto [mem, begin, length, exit] = match->vars<4>();
+
+    std::vector<mim::Lam*> states;
+    for (size_t state = 0; state < automaton.ranges.size(); ++state)
+        states.push_back(world_.mut_con({mem_type, index_type}));
+
+    for (uint32_t state = 0; state < states.size(); ++state) {
+        auto [state_mem, pos] = states[state]->vars<2>();
+
+        auto end = world_.mut_con({mem_type});
+        end->app(false, exit,
+                 {end->var(), world_.lit_bool(state < automaton.accepting)});
+
+        auto step = world_.mut_con({mem_type});
+        auto byte_ptr =
+            world_.call<mim::plug::mem::lea>(mim::DefVec{begin, pos});
+        auto [load_mem, byte] =
+            world_
+                .call<mim::plug::mem::load>(
+                    mim::DefVec{step->var(), byte_ptr})
+                ->projs<2>();
+        auto next = world_.call(
+            mim::plug::core::wrap::add,
+            world_.lit_nat(mim::plug::core::Mode::nuw),
+            mim::DefVec{pos, world_.lit(index_type, 1)});
+
+        // every range is tested by a continuation of its own, which goes on
+        // to the test of the next range if the byte is not in it
+        mim::Lam* test = step;
+        const mim::Def* test_mem = load_mem;
+        bool tested_all = false;
+        for (const auto& range : automaton.ranges[state]) {
+            const mim::Def* in_range = nullptr;
+            if (range.first == range.last) {
+                in_range =
+                    world_.call(mim::plug::core::icmp::e,
+                                mim::DefVec{byte, world_.lit_i8(range.first)});
+            } else if (range.first == 0 && range.last == 255) {
+                test->app(false, states[range.target], {test_mem, next});
+                tested_all = true;
+                break;
+            } else if (range.first == 0) {
+                in_range = world_.call(
+                    mim::plug::core::icmp::ule,
+                    mim::DefVec{byte, world_.lit_i8(range.last)});
+            } else if (range.last == 255) {
+                in_range = world_.call(
+                    mim::plug::core::icmp::uge,
+                    mim::DefVec{byte, world_.lit_i8(range.first)});
+            } else {
+                in_range = world_.call(
+                    mim::plug::core::bit2::and_, world_.lit_nat_0(),
+                    mim::DefVec{
+                        world_.call(
+                            mim::plug::core::icmp::uge,
+                            mim::DefVec{byte, world_.lit_i8(range.first)}),
+                        world_.call(
+                            mim::plug::core::icmp::ule,
+                            mim::DefVec{byte, world_.lit_i8(range.last)})});
+            }
+
+            auto taken = world_.mut_con({mem_type});
+            taken->app(false, states[range.target], {taken->var(), next});
+            auto rest = world_.mut_con({mem_type});
+            test->branch(false, in_range, taken, rest, test_mem);
+            test = rest;
+            test_mem = rest->var();
+        }
+        // the other bytes lead to the dead state
+        if (!tested_all)
+            test->app(false, exit, {test_mem, world_.lit_ff()});
+
+        auto at_end = world_.call(mim::plug::core::icmp::e,
+                                  mim::DefVec{pos, length});
+        states[state]->branch(false, at_end, end, step, state_mem);
+    }
+
+    match->app(false, states[automaton.start],
+               {mem, world_.lit(index_type, 0)});
+}
+
+int MimirCodeGen::compile_to_shared(const std::string& ir,
+                                    const std::string& out) {
+    auto input = ir_path(out);
+    if (options_.bitcode) {
+#ifdef REGEXFE_HAVE_LLVM_JIT
+        // clang reads bitcode faster than it parses the textual IR
+        JitCompiler::write_bitcode(ir, input);
+#endif
+    } else {
+        std::ofstream ofs(input);
+        ofs << ir;
     }
 
 #ifdef _WIN32
@@ -82,34 +418,373 @@ int MimirCodeGen::compile_to_shared(std::string out) {
 #else
     std::string clang_extension = "";
 #endif
-    auto cmd = mim::fmt("clang{} \"{}\" -o \"{}\" -Wno-override-module -shared",
-                        clang_extension, ll, out);
-    int exit = std::system(cmd.c_str());
-    return WEXITSTATUS(exit);
+    auto cmd = mim::fmt("clang{} \"{}\" -o \"{}\" {} {}", clang_extension,
+                        input, out, CLANG_FLAGS, options_.clang_flags());
+    int exit = run_command(cmd);
+
+    std::error_code error;
+    std::filesystem::remove(input, error);
+
+    return exit;
 }
 
-std::function<bool(const char*)> MimirCodeGen::make_matcher(MimRegex re) {
-    mim_match(re);
+// Run the command through the shell like std::system and return its exit
+// status, or -1 if it was terminated. Elsewhere than on Windows, the command
+// runs in a process group of its own, which cancel terminates as a whole, so
+// that no process clang starts, e.g. the linker, outlives the compilation.
+int MimirCodeGen::run_command(const std::string& command) {
+#ifdef _WIN32
+    throw_if_cancelled();
+    return std::system(command.c_str());
+#else
+    auto script = "exec " + command;
+    const char* argv[] = {"sh", "-c", script.c_str(), nullptr};
+
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attributes, 0);
+
+    pid_t pid = 0;
+    int spawned;
+    {
+        std::lock_guard lock(child_mutex_);
+        throw_if_cancelled();
+        spawned = posix_spawn(&pid, "/bin/sh", nullptr, &attributes,
+                              const_cast<char* const*>(argv), environ);
+        if (spawned == 0) child_ = pid;
+    }
+    posix_spawnattr_destroy(&attributes);
+    if (spawned != 0) return -1;
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {
+    }
+
+    {
+        std::lock_guard lock(child_mutex_);
+        child_ = 0;
+    }
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+void MimirCodeGen::cancel() {
+    std::unique_lock lock(child_mutex_);
+    cancelled_ = true;
+#ifndef _WIN32
+    // clang removes its temporary files when terminated, unlike when killed
+    if (child_ != 0) kill(-static_cast<pid_t>(child_), SIGTERM);
+#endif
+    // the step removes the files of the terminated clang
+    file_steps_done_.wait(lock, [this] { return file_steps_ == 0; });
+}
+
+class MimirCodeGen::FileStep {
+    MimirCodeGen& code_gen_;
+
+   public:
+    // Throws std::runtime_error if the compilation was cancelled.
+    explicit FileStep(MimirCodeGen& code_gen) : code_gen_(code_gen) {
+        std::lock_guard lock(code_gen_.child_mutex_);
+        code_gen_.throw_if_cancelled();
+        ++code_gen_.file_steps_;
+    }
+
+    FileStep(const FileStep&) = delete;
+    FileStep& operator=(const FileStep&) = delete;
+
+    ~FileStep() {
+        {
+            std::lock_guard lock(code_gen_.child_mutex_);
+            --code_gen_.file_steps_;
+        }
+        code_gen_.file_steps_done_.notify_all();
+    }
+};
+
+void MimirCodeGen::throw_if_cancelled() const {
+    if (cancelled_)
+        throw std::runtime_error{"0: error: The compilation was cancelled."};
+}
+
+Matcher MimirCodeGen::make_matcher(const MatcherSource& source) {
+    return make_matchers({source}).front();
+}
+
+std::vector<Matcher> MimirCodeGen::make_matchers(
+    const std::vector<MatcherSource>& sources) {
+    // the key of a regex identifies its compiled matcher in this process and
+    // names its functions, the cache also hashes the IR generated for it
+    std::vector<std::string> ids;
+    std::vector<const MatcherSource*> pending;
+    std::vector<SpanAutomaton> automata;
+    std::vector<std::string> pending_ids;
+    std::unordered_set<std::string> seen;
+    for (const auto& source : sources) {
+        auto id = MatcherCache::make_key({source.key});
+
+        if (!matchers_.contains(id) && seen.insert(id).second) {
+            if (auto automaton = span_automaton(source.program)) {
+                pending.push_back(&source);
+                automata.push_back(std::move(*automaton));
+                pending_ids.push_back(id);
+            } else {
+                world_.DLOG("Matching regex {} on a lazy DFA", id);
+                matchers_.emplace(
+                    id, Matcher(std::make_shared<LazyDfa>(source.program)));
+            }
+        }
+        ids.push_back(std::move(id));
+    }
+
+    if (!pending.empty()) {
+        auto compiled = compile(pending, automata, pending_ids);
+        for (size_t i = 0; i < compiled.size(); ++i)
+            matchers_.emplace(pending_ids[i], std::move(compiled[i]));
+    }
+
+    std::vector<Matcher> matchers;
+    matchers.reserve(ids.size());
+    for (const auto& id : ids) matchers.push_back(matchers_.at(id));
+    return matchers;
+}
+
+// Compile the regexes, which have not been compiled before, into one module.
+std::vector<Matcher> MimirCodeGen::compile(
+    const std::vector<const MatcherSource*>& sources,
+    const std::vector<SpanAutomaton>& automata,
+    const std::vector<std::string>& ids) {
+    throw_if_cancelled();
+
+    std::vector<std::string> names;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        names.push_back(symbol_name(MATCHER_FUNC_NAME, ids[i]));
+        mim_match(sources[i]->regex, names.back());
+        names.push_back(symbol_name(MATCHER_SPAN_FUNC_NAME, ids[i]));
+        mim_match_span(automata[i], names.back());
+    }
 
     mim::optimize(world_);
 
-    auto tmp = std::filesystem::temp_directory_path();
+    std::ostringstream ir;
+    emit_llvm(ir);
+
+    // the IR of later regexes must not contain these functions again
+    for (const auto& name : names)
+        if (auto def = world_.external(world_.sym(name))) def->make_internal();
+
+    throw_if_cancelled();
 
-    auto shared_lib = mim::fmt("{}/regex-{}.{}", tmp.string(),
-                               std::this_thread::get_id(), mim::dl::extension);
+    // the regexes compiled together are cached together, keyed on the code
+    // generated for them, as a cached matcher only saves compiling the IR
+    std::string identity;
+    for (const auto& id : ids) identity += id;
+    identity += MatcherCache::make_key({canonical_ir(ir.str())});
+
+    if (cache_)
+        if (auto matchers = load_cached(identity, ids)) return *matchers;
+
+    if (backend_ == Backend::Jit && has_jit()) {
+        try {
+            return compile_with_jit(ir.str(), identity, ids);
+        } catch (const std::runtime_error& e) {
+            world_.WLOG("JIT compilation failed, falling back to clang: {}",
+                        e.what());
+        }
+    }
+
+    return compile_with_clang(ir.str(), identity, ids);
+}
 
-    if (compile_to_shared(shared_lib) == 0)
-        world_.DLOG("Compiled regex to shared library: {}", shared_lib);
-    else
+// The file compile_to_shared writes the IR for the shared library at path to.
+std::string MimirCodeGen::ir_path(const std::string& path) const {
+    return path + (options_.bitcode ? ".bc" : ".ll");
+}
+
+// Write the whole world as textual LLVM IR.
+void MimirCodeGen::emit_llvm(std::ostream& os) {
+    driver_.backend("ll")(world_, os);
+}
+
+// Hash everything the compiled matchers depend on: the regexes and the IR
+// generated for them, the build, the backend, the compiler and the options it
+// compiles with, and the CPU of this machine if they compile for it.
+std::string MimirCodeGen::cache_key(const std::string& identity,
+                                    Backend backend) const {
+#ifdef REGEXFE_HAVE_LLVM_JIT
+    if (backend == Backend::Jit)
+        return MatcherCache::make_key(
+            {BUILD_ID, "jit", JitCompiler::target_identity(),
+             options_.clang_flags(), identity});
+#endif
+    return MatcherCache::make_key(
+        {BUILD_ID, "clang", clang_identity(), CLANG_FLAGS,
+         options_.clang_flags(),
+         targets_host(options_) ? host_cpu_identity() : "", identity});
+}
+
+// Load the matchers of regexes compiled by an earlier run, if they are
+// cached. A broken entry is ignored, the regexes are compiled again then.
+std::optional<std::vector<Matcher>> MimirCodeGen::load_cached(
+    const std::string& identity, const std::vector<std::string>& ids) {
+    try {
+#ifdef REGEXFE_HAVE_LLVM_JIT
+        if (backend_ == Backend::Jit) {
+            auto object =
+                cache_->find(cache_key(identity, Backend::Jit), ".o");
+            if (object) {
+                auto jit = std::make_shared<JitCompiler>();
+                jit->add_object_file(object->string());
+                world_.DLOG("Loaded cached regexes: {}", object->string());
+                return jit_matchers(std::move(jit), ids);
+            }
+        }
+#endif
+        auto extension = mim::fmt(".{}", mim::dl::extension);
+        auto lib =
+            cache_->find(cache_key(identity, Backend::Clang), extension);
+        if (lib) {
+            world_.DLOG("Loaded cached regexes: {}", lib->string());
+            return load_shared(lib->string(), ids, false);
+        }
+    } catch (const std::exception& e) {
+        world_.WLOG("Ignoring cached regexes: {}", e.what());
+    }
+
+    return std::nullopt;
+}
+
+// Compile the LLVM IR in memory, no file or process is involved.
+std::vector<Matcher> MimirCodeGen::compile_with_jit(
+    [[maybe_unused]] const std::string& ir,
+    [[maybe_unused]] const std::string& identity,
+    [[maybe_unused]] const std::vector<std::string>& ids) {
+#ifdef REGEXFE_HAVE_LLVM_JIT
+    // a JIT of its own per module, like a shared library of its own below
+    auto jit = std::make_shared<JitCompiler>(options_);
+    jit->add_module(ir, "regex");
+
+    // looking up the functions compiles them
+    auto matchers = jit_matchers(jit, ids);
+    world_.DLOG("Compiled {} regexes with the JIT", ids.size());
+
+    if (cache_) {
+        FileStep step(*this);
+        try {
+            cache_->insert(cache_key(identity, Backend::Jit), ".o",
+                           jit->compiled_object());
+        } catch (const std::exception& e) {
+            world_.WLOG("Failed to cache the compiled regexes: {}", e.what());
+        }
+    }
+
+    return matchers;
+#else
+    throw std::runtime_error{"0: error: The JIT backend is not available."};
+#endif
+}
+
+std::vector<Matcher> MimirCodeGen::compile_with_clang(
+    const std::string& ir, const std::string& identity,
+    const std::vector<std::string>& ids) {
+    auto extension = mim::fmt(".{}", mim::dl::extension);
+
+    // from writing the IR to loading the library, which removes a temporary one
+    FileStep step(*this);
+
+    std::string key;
+    std::filesystem::path shared_lib;
+    if (cache_) {
+        key = cache_key(identity, Backend::Clang);
+        shared_lib = cache_->temporary_path(key, extension);
+    } else {
+        shared_lib =
+            temporary_library_path(MatcherCache::make_key({identity}));
+    }
+
+    if (compile_to_shared(ir, shared_lib.string()) == 0) {
+        world_.DLOG("Compiled {} regexes to shared library: {}", ids.size(),
+                    shared_lib.string());
+    } else {
+        // clang may have been terminated while writing it
+        std::error_code error;
+        std::filesystem::remove(shared_lib, error);
+        throw_if_cancelled();
         throw std::runtime_error{
             "0: error: Failed to compile regex to shared library."};
+    }
 
+    // without a cache, the library is only needed as long as it is loaded
+    bool temporary = !cache_;
+    if (cache_) {
+        try {
+            shared_lib = cache_->publish(shared_lib, key, extension);
+        } catch (const std::exception& e) {
+            world_.WLOG("Failed to cache the compiled regexes: {}", e.what());
+            temporary = true;
+        }
+    }
+
+    return load_shared(shared_lib.string(), ids, temporary);
+}
+
+std::vector<Matcher> MimirCodeGen::jit_matchers(
+    [[maybe_unused]] std::shared_ptr<JitCompiler> jit,
+    [[maybe_unused]] const std::vector<std::string>& ids) {
+#ifdef REGEXFE_HAVE_LLVM_JIT
+    std::vector<Matcher> matchers;
+    matchers.reserve(ids.size());
+    for (const auto& id : ids) {
+        auto c_string_fn = reinterpret_cast<Matcher::CStringFunction>(
+            jit->lookup(symbol_name(MATCHER_FUNC_NAME, id)));
+        auto span_fn = reinterpret_cast<Matcher::SpanFunction>(
+            jit->lookup(symbol_name(MATCHER_SPAN_FUNC_NAME, id)));
+        matchers.emplace_back(c_string_fn, span_fn, jit);
+    }
+    return matchers;
+#else
+    throw std::runtime_error{"0: error: The JIT backend is not available."};
+#endif
+}
+
+// Load the shared library, which is unloaded with the last of the matchers.
+// A temporary library is deleted as well, see below.
+std::vector<Matcher> MimirCodeGen::load_shared(
+    const std::string& path, const std::vector<std::string>& ids,
+    bool temporary) {
+    // Elsewhere than on Windows, a loaded library no longer needs its file, so
+    // a temporary one is removed right away, which leaves nothing behind even
+    // if the process exits without unloading the library.
+#ifdef _WIN32
+    const bool remove_on_close = temporary;
+#else
+    const bool remove_on_close = false;
+#endif
     // dl::open throws on error
-    jit_lib_.reset(mim::dl::open(shared_lib.c_str()));
+    std::shared_ptr<void> lib(mim::dl::open(path.c_str()),
+                              [path, remove_on_close](void* handle) {
+                                  mim::dl::close(handle);
+                                  std::error_code error;
+                                  if (remove_on_close)
+                                      std::filesystem::remove(path, error);
+                              });
+    if (temporary && !remove_on_close) {
+        std::error_code error;
+        std::filesystem::remove(path, error);
+    }
 
-    std::function<bool(const char*)> fn_handle =
-        (bool (*)(const char*))mim::dl::get(jit_lib_.get(), MATCHER_FUNC_NAME);
-    return fn_handle;
+    std::vector<Matcher> matchers;
+    matchers.reserve(ids.size());
+    for (const auto& id : ids) {
+        auto c_string_fn = (Matcher::CStringFunction)mim::dl::get(
+            lib.get(), symbol_name(MATCHER_FUNC_NAME, id).c_str());
+        auto span_fn = (Matcher::SpanFunction)mim::dl::get(
+            lib.get(), symbol_name(MATCHER_SPAN_FUNC_NAME, id).c_str());
+        matchers.emplace_back(c_string_fn, span_fn, lib);
+    }
+    return matchers;
 }
 
 // MimIR construction wrappers
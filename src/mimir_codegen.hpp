@@ -10,7 +10,23 @@
 #include <mim/plug/regex/regex.h>
 #include <mim/world.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "codegen_options.hpp"
+#include "matcher.hpp"
+#include "pike_vm.hpp"
+
+class JitCompiler;
+class MatcherCache;
 
 // MimChar represents a single character literal in MimIR.
 // It should be constructed via MimirCodeGen::char_lit.
@@ -103,6 +119,19 @@ class MimRegex {
 // Character classes for regex character classes, e.g. \d, \D, \w, \W, \s, \S
 using cls = mim::plug::regex::cls;
 
+// The regex of a compiled matcher in the two forms its functions are generated
+// from: the MimIR of the regex for the function on NUL-terminated strings, and
+// the program of the regex for the function on spans, see DfaTable. Build it
+// with Expression::generateMatcherSource.
+struct MatcherSource {
+    MimRegex regex;
+    PikeProgram program;
+    // Identifies the regex in this process, the same for two regexes exactly
+    // if their ASTs are, see Expression::appendKey. The keys of cached
+    // matchers hash the IR generated for the regex as well.
+    std::string key;
+};
+
 // MimirCodeGen is a helper class to generate MimIR for regular expressions.
 // It hides all the MimIR details and provides a simple interface to construct
 // regexes.
@@ -113,13 +142,20 @@ using cls = mim::plug::regex::cls;
 // MimChar c = codegen.char_lit('a'); // character literal 'a'
 // MimRegex r = codegen.regex_lit(c); // regex matching 'a'
 // r = codegen.regex_star(r);         // regex matching 'a'*
-// auto matcher = codegen.make_matcher(r); // compile the regex to a matcher
-// function bool matches = matcher("aa");      // use the matcher function
+// ```
+// Regexes parsed from patterns are compiled like this:
+// ```
+// auto matcher =
+//     codegen.make_matcher(expression->generateMatcherSource(codegen));
+// bool matches = matcher("aa");            // match a C-string
+// matches = matcher(buf + 3, 2);           // match the span buf[3..5)
 // ```
 class MimirCodeGen {
-    using LibHandle = std::unique_ptr<void, void (*)(void*)>;
-
+    // The names of the generated functions start with these prefixes and end
+    // with the id of the regex, so that every matcher has its own symbols.
     static constexpr const char* MATCHER_FUNC_NAME = "mim_match_regex";
+    static constexpr const char* MATCHER_SPAN_FUNC_NAME =
+        "mim_match_regex_span";
 
    public:
     // Construct the MimirCodeGen and its internal MimIR world.
@@ -131,8 +167,38 @@ class MimirCodeGen {
     MimirCodeGen(const MimirCodeGen&) = delete;
     MimirCodeGen& operator=(const MimirCodeGen&) = delete;
 
+    ~MimirCodeGen();
+
     using LogLevel = mim::Log::Level;
 
+    // The backend that turns the generated LLVM IR into machine code.
+    // Jit compiles the IR in-process with LLVM's ORC JIT. It is only available
+    // if the project was built with LLVM (REGEXFE_HAVE_LLVM_JIT) and is the
+    // default then. Clang writes the IR to a temporary file, runs clang to
+    // build a shared library and loads that.
+    // If the Jit backend fails, make_matcher falls back to Clang.
+    enum class Backend { Jit, Clang };
+
+    // Select the backend used by make_matcher.
+    void set_backend(Backend backend);
+
+    // Whether this build includes the Jit backend.
+    static bool has_jit();
+
+    // Set how the generated LLVM IR is compiled by either backend, e.g. the
+    // optimization level and the target CPU. Throws std::runtime_error if the
+    // options are invalid, or if they need LLVM and this build lacks it.
+    // Unknown CPUs are only reported when compiling.
+    void set_codegen_options(CodeGenOptions options);
+
+    // Use the given cache for compiled matchers. make_matcher then loads the
+    // matcher of a regex compiled by an earlier run instead of compiling it,
+    // and stores newly compiled matchers. Pass nullptr to disable caching.
+    // The IR of a regex is still generated, as it is part of the key, so
+    // that a change to the code generation never loads stale code; only
+    // compiling the IR to machine code is saved.
+    void set_cache(std::shared_ptr<MatcherCache> cache);
+
     // Set the logging level for the internal MimIR world.
     // By default, the logging level is LogLevel::Error.
     // When setting to LogLevel::Debug, a lot of output is generated.
@@ -225,22 +291,108 @@ class MimirCodeGen {
 
     /// MimIR construction wrappers end
 
-    // Compile the given MimRegex into a matcher function.
-    // The returned function takes a const char* (C-string) as input and returns
-    // true if the input matches the regex, false otherwise. The returned
-    // function is valid as long as the MimirCodeGen instance is alive. It
-    // throws std::runtime_error if compilation fails.
-    std::function<bool(const char*)> make_matcher(MimRegex re);
+    // Compile the given regex into a Matcher.
+    // The returned Matcher can be called with a const char* (C-string) or with
+    // a (const char* begin, size_t length) span and returns true if the input
+    // matches the regex, false otherwise. The function on C-strings is
+    // generated from the MimIR of the regex. The function on spans is MimIR
+    // generated from the DfaTable of its program, with a continuation per
+    // state that stops at the end of the span, as the automata of the regex
+    // plugin cannot be bounded by a length. The returned Matcher owns its
+    // code, so it stays valid after further calls and after the MimirCodeGen
+    // instance is destroyed. Making a matcher for the same regex again
+    // returns the one compiled before.
+    // A regex whose DFA is too large to be compiled, as the DFA of a few
+    // regexes is exponentially larger than the regex, is not compiled: its
+    // matcher runs on a LazyDfa, which gives the same results, and is not
+    // promoted(). It throws std::runtime_error if compilation fails.
+    //
+    // A MimirCodeGen must only be used by one thread at a time. To compile on
+    // several threads, use one instance per thread, see CompileService.
+    Matcher make_matcher(const MatcherSource& source);
+
+    // Compile the given regexes into a single module with one compiler run
+    // and return their matchers in the same order. The fixed cost of a
+    // compilation, i.e. emitting LLVM IR, running the compiler and loading
+    // the code, is thus paid once for all of them, which makes this much
+    // faster than calling make_matcher for each of a large set of regexes.
+    // The matchers share their code, which is freed with the last of them.
+    std::vector<Matcher> make_matchers(
+        const std::vector<MatcherSource>& sources);
+
+    // Stop the compilation running on another thread, and every later one:
+    // make_matcher throws std::runtime_error then, as soon as the current step
+    // is done. A clang process it waits for is terminated. cancel returns once
+    // no step that writes files runs anymore, i.e. once a terminated clang's
+    // files are removed and a write to the cache is complete, and no such
+    // step starts afterwards, so the process may exit right away without
+    // leaving a file behind. Compiling in the JIT cannot be interrupted: that
+    // step runs to its end, writes nothing, and only then make_matcher throws.
+    // Unlike everything else, cancel may be called from any thread while
+    // make_matcher runs.
+    void cancel();
 
    private:
     static mim::DefVec to_defvec(const std::vector<MimRegex>& exprs);
 
-    void mim_match(const mim::Def* re);
+    // The DFA of a regex, as the ranges of bytes leading from every state to
+    // another one.
+    struct SpanAutomaton;
+    static std::optional<SpanAutomaton> span_automaton(
+        const PikeProgram& program);
+
+    void mim_match(const mim::Def* re, const std::string& name);
+    void mim_match_span(const SpanAutomaton& automaton,
+                        const std::string& name);
+
+    void emit_llvm(std::ostream& os);
+    std::string ir_path(const std::string& path) const;
+
+    std::vector<Matcher> compile(
+        const std::vector<const MatcherSource*>& sources,
+        const std::vector<SpanAutomaton>& automata,
+        const std::vector<std::string>& ids);
+
+    std::string cache_key(const std::string& identity, Backend backend) const;
+    std::optional<std::vector<Matcher>> load_cached(
+        const std::string& identity, const std::vector<std::string>& ids);
+
+    std::vector<Matcher> compile_with_jit(const std::string& ir,
+                                          const std::string& identity,
+                                          const std::vector<std::string>& ids);
+    std::vector<Matcher> compile_with_clang(
+        const std::string& ir, const std::string& identity,
+        const std::vector<std::string>& ids);
+
+    std::vector<Matcher> jit_matchers(std::shared_ptr<JitCompiler> jit,
+                                      const std::vector<std::string>& ids);
+    std::vector<Matcher> load_shared(const std::string& path,
+                                     const std::vector<std::string>& ids,
+                                     bool temporary);
+
+    int compile_to_shared(const std::string& ir, const std::string& out);
+    int run_command(const std::string& command);
+    void throw_if_cancelled() const;
 
-    int compile_to_shared(std::string out);
+    // Brackets a step of the compilation that writes files, see cancel.
+    class FileStep;
 
     mim::Driver driver_;
     mim::World& world_;
 
-    LibHandle jit_lib_;
+    Backend backend_;
+    CodeGenOptions options_;
+    std::shared_ptr<MatcherCache> cache_;
+
+    // The matchers compiled so far, by the id of their regex.
+    std::unordered_map<std::string, Matcher> matchers_;
+
+    // Set by cancel. The mutex guards starting and terminating the process
+    // run_command waits for, whose id is child_, or 0, and the number of
+    // FileSteps running, which is signalled when it drops to 0.
+    std::atomic<bool> cancelled_ = false;
+    std::mutex child_mutex_;
+    long child_ = 0;
+    int file_steps_ = 0;
+    std::condition_variable file_steps_done_;
 };
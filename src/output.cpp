@@ -0,0 +1,139 @@
+#include "output.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+OutputWriter::OutputWriter(const int fd, const bool line_buffered) : fd(fd), line_buffered(line_buffered) {
+    blocks.reserve(block_count);
+    blocks.push_back(std::make_unique<char[]>(block_size));
+}
+
+OutputWriter::~OutputWriter() {
+    try {
+        flush();
+    }
+    catch (const std::runtime_error&) {
+        // there is nobody left to report the error to
+    }
+}
+
+void OutputWriter::write(const char* data, size_t length) {
+
+    while (length > 0) {
+
+        if (current_used == block_size) {
+            next_block();
+        }
+
+        const size_t n = std::min(length, block_size - current_used);
+        std::memcpy(blocks[current_block].get() + current_used, data, n);
+
+        current_used += n;
+        data += n;
+        length -= n;
+    }
+
+}
+
+void OutputWriter::next_block() {
+
+    if (current_block + 1 == block_count) {
+        flush();
+        return;
+    }
+
+    current_block++;
+    current_used = 0;
+
+    if (current_block == blocks.size()) {
+        blocks.push_back(std::make_unique<char[]>(block_size));
+    }
+
+}
+
+#ifndef _WIN32
+
+void OutputWriter::flush() {
+
+    iovec iov[block_count];
+    size_t iov_count = 0;
+
+    for (size_t i = 0; i <= current_block; i++) {
+        const size_t used = i == current_block ? current_used : block_size;
+        if (used > 0) {
+            iov[iov_count++] = {blocks[i].get(), used};
+        }
+    }
+
+    current_block = 0;
+    current_used = 0;
+
+    iovec* pending = iov;
+
+    while (iov_count > 0) {
+
+        const ssize_t written = ::writev(fd, pending, static_cast<int>(iov_count));
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("0: error: failed to write output.");
+        }
+
+        // skip over everything that was written, the last vector may have been written partially
+        auto remaining = static_cast<size_t>(written);
+
+        while (iov_count > 0 && remaining >= pending->iov_len) {
+            remaining -= pending->iov_len;
+            pending++;
+            iov_count--;
+        }
+
+        if (iov_count > 0) {
+            pending->iov_base = static_cast<char*>(pending->iov_base) + remaining;
+            pending->iov_len -= remaining;
+        }
+    }
+
+}
+
+#else
+
+void OutputWriter::flush() {
+
+    for (size_t i = 0; i <= current_block; i++) {
+        write_all(blocks[i].get(), i == current_block ? current_used : block_size);
+    }
+
+    current_block = 0;
+    current_used = 0;
+
+}
+
+void OutputWriter::write_all(const char* data, size_t length) const {
+
+    while (length > 0) {
+
+        const int written = ::_write(fd, data, static_cast<unsigned int>(length));
+
+        if (written < 0) {
+            throw std::runtime_error("0: error: failed to write output.");
+        }
+
+        data += written;
+        length -= static_cast<size_t>(written);
+    }
+
+}
+
+#endif
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// OutputWriter collects the output of the program in a set of large, reusable blocks and hands all filled
+// blocks to the operating system with a single writev call once they are exhausted, or when flush() is called.
+//
+// In line-buffered mode, every completed line is written immediately, which is what interactive use expects.
+class OutputWriter final {
+
+    static constexpr size_t block_size = 1 << 16;
+    static constexpr size_t block_count = 16;
+
+    const int fd;
+    const bool line_buffered;
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    // index of the block currently being filled and the number of bytes used in it
+    size_t current_block = 0;
+    size_t current_used = 0;
+
+#ifdef _WIN32
+    void write_all(const char* data, size_t length) const;
+#endif
+
+    void next_block();
+
+public:
+    static constexpr int stdout_fd = 1;
+
+    explicit OutputWriter(int fd, bool line_buffered = false);
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+    // Flushes the remaining output, errors are ignored at this point.
+    ~OutputWriter();
+
+    [[nodiscard]] bool is_line_buffered() const {
+        return line_buffered;
+    }
+
+    void write(const char* data, size_t length);
+
+    void write(const std::string_view str) {
+        write(str.data(), str.size());
+    }
+
+    void put(const char c) {
+        if (current_used == block_size) {
+            next_block();
+        }
+        blocks[current_block][current_used++] = c;
+    }
+
+    // Terminates the current line, flushing it in line-buffered mode.
+    void end_line() {
+        put('\n');
+        if (line_buffered) {
+            flush();
+        }
+    }
+
+    // Writes everything buffered so far, throws std::runtime_error if writing fails.
+    void flush();
+
+};
+
+// StringOutput offers the interface of OutputWriter, but collects the output in memory,
+// e.g. the results of one chunk of a parallel scan before they are written in order.
+class StringOutput final {
+
+    std::string buffer;
+
+public:
+    void write(const char* data, const size_t length) {
+        buffer.append(data, length);
+    }
+
+    void write(const std::string_view str) {
+        buffer.append(str);
+    }
+
+    void put(const char c) {
+        buffer.push_back(c);
+    }
+
+    void end_line() {
+        buffer.push_back('\n');
+    }
+
+    [[nodiscard]] std::string_view view() const {
+        return buffer;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return buffer.size();
+    }
+
+    void clear() {
+        buffer.clear();
+    }
+
+};
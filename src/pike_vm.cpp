@@ -0,0 +1,171 @@
+#include "pike_vm.hpp"
+
+#include <cassert>
+#include <utility>
+
+namespace {
+
+// The threads of one step as a sparse set of instruction indices, which is cleared in constant time
+// and keeps the order of insertion.
+class ThreadList final {
+
+    std::vector<uint32_t> dense;
+    std::vector<uint32_t> sparse;
+    size_t count = 0;
+
+public:
+    // Empties the list and makes room for the instructions of a program of the given size.
+    void reset(const size_t instructions) {
+        if (sparse.size() < instructions) {
+            sparse.resize(instructions);
+            dense.resize(instructions);
+        }
+        count = 0;
+    }
+
+    [[nodiscard]] bool contains(const uint32_t instruction) const {
+        const uint32_t position = sparse[instruction];
+        return position < count && dense[position] == instruction;
+    }
+
+    void insert(const uint32_t instruction) {
+        sparse[instruction] = static_cast<uint32_t>(count);
+        dense[count++] = instruction;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return count == 0;
+    }
+
+    [[nodiscard]] const uint32_t* begin() const {
+        return dense.data();
+    }
+
+    [[nodiscard]] const uint32_t* end() const {
+        return dense.data() + count;
+    }
+
+};
+
+// per thread, so that matching allocates nothing once the lists have grown to the largest program
+struct Scratch {
+    ThreadList current;
+    ThreadList next;
+    std::vector<uint32_t> stack;
+};
+
+thread_local Scratch scratch;
+
+}
+
+PikeProgram::PikeProgram() {
+    instructions.push_back(Instruction{Opcode::Match, 0, 0, ByteSet()});
+}
+
+uint32_t PikeProgram::emit_bytes(const ByteSet& bytes, const uint32_t next) {
+    instructions.push_back(Instruction{Opcode::Byte, next, 0, bytes});
+    return static_cast<uint32_t>(instructions.size() - 1);
+}
+
+uint32_t PikeProgram::emit_split(const uint32_t next, const uint32_t alternative) {
+    instructions.push_back(Instruction{Opcode::Split, next, alternative, ByteSet()});
+    return static_cast<uint32_t>(instructions.size() - 1);
+}
+
+uint32_t PikeProgram::reserve_split() {
+    return emit_split(match(), match());
+}
+
+void PikeProgram::set_split(const uint32_t index, const uint32_t next, const uint32_t alternative) {
+    assert(instructions[index].opcode == Opcode::Split);
+    instructions[index].next = next;
+    instructions[index].alternative = alternative;
+}
+
+void PikeProgram::set_start(const uint32_t index) {
+    start = index;
+}
+
+size_t PikeProgram::byte_classes(std::array<uint8_t, 256>& classes) const {
+
+    // bytes that are in the same sets of every instruction behave the same, so each set splits the classes
+    // into the bytes inside and outside of it
+    classes.fill(0);
+    size_t count = 1;
+    for (const Instruction& instruction : instructions) {
+        if (instruction.opcode != Opcode::Byte) {
+            continue;
+        }
+
+        std::vector<int> renumbered(count * 2, -1);
+        size_t refined = 0;
+        for (unsigned byte = 0; byte < 256; byte++) {
+            const size_t key = classes[byte] * 2 + instruction.bytes.contains(static_cast<unsigned char>(byte));
+            if (renumbered[key] < 0) {
+                renumbered[key] = static_cast<int>(refined++);
+            }
+            classes[byte] = static_cast<uint8_t>(renumbered[key]);
+        }
+        count = refined;
+    }
+
+    return count;
+
+}
+
+// Adds the thread at the instruction and, following the splits, every thread it continues with without
+// consuming input. Each instruction is added at most once per step, which also ends loops of splits.
+static void add_thread(const std::vector<PikeProgram::Instruction>& instructions, ThreadList& threads,
+                       const uint32_t instruction, std::vector<uint32_t>& stack) {
+
+    stack.push_back(instruction);
+
+    while (!stack.empty()) {
+        const uint32_t index = stack.back();
+        stack.pop_back();
+
+        if (threads.contains(index)) {
+            continue;
+        }
+        threads.insert(index);
+
+        if (const PikeProgram::Instruction& split = instructions[index]; split.opcode == PikeProgram::Opcode::Split) {
+            stack.push_back(split.alternative);
+            stack.push_back(split.next);
+        }
+    }
+
+}
+
+bool PikeProgram::matches(const char* begin, const size_t length) const {
+
+    ThreadList* current = &scratch.current;
+    ThreadList* next = &scratch.next;
+
+    current->reset(instructions.size());
+    next->reset(instructions.size());
+
+    add_thread(instructions, *current, start, scratch.stack);
+
+    for (size_t i = 0; i < length; i++) {
+        const auto byte = static_cast<unsigned char>(begin[i]);
+
+        for (const uint32_t index : *current) {
+            const Instruction& instruction = instructions[index];
+            if (instruction.opcode == Opcode::Byte && instruction.bytes.contains(byte)) {
+                add_thread(instructions, *next, instruction.next, scratch.stack);
+            }
+        }
+
+        std::swap(current, next);
+        next->reset(instructions.size());
+
+        // no thread is left, the rest of the input cannot match anymore
+        if (current->empty()) {
+            return false;
+        }
+    }
+
+    return current->contains(match());
+
+}
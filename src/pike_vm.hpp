@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "byte_set.hpp"
+#include "matcher.hpp"
+
+// PikeProgram is a regex compiled to a Thompson NFA, which the Pike VM runs directly, without generating code.
+// It is built from the AST in microseconds, so matching can start at once while the regex is compiled to
+// machine code, see TieredCompiler.
+//
+// The VM advances all threads of the NFA in lockstep over the input, one byte at a time, which takes
+// O(length * instructions) time and never backtracks. As the regex has no captures, a thread is just its
+// instruction, thus the threads are a set of instructions.
+//
+// The program is built back to front: every piece of the regex is emitted with the index of the instruction
+// that follows it, i.e. its continuation, and returns the index of its first instruction.
+class PikeProgram final : public MatchEngine {
+
+public:
+    enum class Opcode : uint8_t {
+        // consume one byte of the set and continue at next
+        Byte,
+        // continue at both next and alternative
+        Split,
+        // the input matches if it ends here
+        Match
+    };
+
+    struct Instruction {
+        Opcode opcode;
+        uint32_t next;
+        uint32_t alternative;
+        ByteSet bytes;
+    };
+
+private:
+    std::vector<Instruction> instructions;
+    uint32_t start = 0;
+
+public:
+    // Creates a program with just the Match instruction, whose index is match().
+    PikeProgram();
+
+    [[nodiscard]] static constexpr uint32_t match() {
+        return 0;
+    }
+
+    // Emits an instruction that consumes a byte of the set and returns its index.
+    uint32_t emit_bytes(const ByteSet& bytes, uint32_t next);
+
+    // Emits an instruction that continues at both instructions and returns its index.
+    uint32_t emit_split(uint32_t next, uint32_t alternative);
+
+    // Emits a placeholder for a split whose first branch is emitted later, e.g. the body of a loop
+    // that continues at the split. Returns its index for set_split.
+    uint32_t reserve_split();
+
+    void set_split(uint32_t index, uint32_t next, uint32_t alternative);
+
+    // Makes the instruction the entry point of the program.
+    void set_start(uint32_t index);
+
+    [[nodiscard]] size_t size() const {
+        return instructions.size();
+    }
+
+    [[nodiscard]] const Instruction& instruction(const uint32_t index) const {
+        return instructions[index];
+    }
+
+    // The index of the first instruction.
+    [[nodiscard]] uint32_t entry() const {
+        return start;
+    }
+
+    // Numbers the classes of bytes that no instruction tells apart, i.e. that are in the same sets of all of them,
+    // stores the class of every byte and returns the number of classes. The automata built from the program
+    // need a transition per class rather than per byte.
+    size_t byte_classes(std::array<uint8_t, 256>& classes) const;
+
+    // Whether the whole span matches, like the compiled span function. Safe to call from several threads.
+    [[nodiscard]] bool matches(const char* begin, size_t length) const override;
+
+};
@@ -0,0 +1,74 @@
+#include "prefilter.hpp"
+
+#include <cstring>
+#include <utility>
+
+// Searches the literal with memchr for its first byte, which is vectorized by the C library, and memcmp for the
+// rest of it.
+static bool contains(const char* begin, const size_t length, const std::string& literal) {
+
+    if (literal.size() > length) {
+        return false;
+    }
+
+    const char* const last = begin + (length - literal.size());
+    const char* position = begin;
+
+    while (position <= last) {
+        const auto* found = static_cast<const char*>(
+            std::memchr(position, literal[0], static_cast<size_t>(last - position) + 1));
+        if (found == nullptr) {
+            return false;
+        }
+        if (std::memcmp(found + 1, literal.data() + 1, literal.size() - 1) == 0) {
+            return true;
+        }
+        position = found + 1;
+    }
+
+    return false;
+
+}
+
+std::shared_ptr<const Prefilter> Prefilter::make(const LengthBounds bounds, const EdgeBytes edges,
+                                                 std::vector<std::string> literals) {
+
+    if (!bounds.restrictive() && !edges.restrictive() && literals.empty()) {
+        return nullptr;
+    }
+
+    return std::make_shared<Prefilter>(bounds, edges, std::move(literals));
+
+}
+
+Prefilter::Prefilter(const LengthBounds bounds, const EdgeBytes edges, std::vector<std::string> literals)
+    : bounds(bounds), edges(edges), literals(std::move(literals)),
+      state(this->literals.empty() ? State::Disabled : State::Probation) {}
+
+bool Prefilter::contains_literal(const char* begin, const size_t length) const {
+
+    for (const std::string& literal : literals) {
+        if (contains(begin, length, literal)) {
+            return true;
+        }
+    }
+
+    return false;
+
+}
+
+void Prefilter::record(const bool passed) const {
+
+    if (!passed) {
+        rejected.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // the thread checking the last line of the probation period decides
+    if (checked.fetch_add(1, std::memory_order_relaxed) + 1 != probation_lines) {
+        return;
+    }
+
+    const bool selective = rejected.load(std::memory_order_relaxed) * 16 >= probation_lines * min_rejected_sixteenths;
+    state.store(selective ? State::Enabled : State::Disabled, std::memory_order_relaxed);
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "edge_bytes.hpp"
+#include "length_bounds.hpp"
+
+// Prefilter rejects lines that cannot match, before they reach the matcher: lines whose length is out of the
+// LengthBounds of the regex, lines that start or end with a byte no match starts or ends with, see EdgeBytes,
+// and lines that lack every literal the regex requires, see LiteralInfo. Checking the length and the edges
+// takes no time at all, and searching a literal with memchr and memcmp is much cheaper than running the
+// matcher. All other lines are matched as usual.
+//
+// Whether the literal search pays off depends on the input: if most lines contain a literal, the search is
+// wasted. The first lines are therefore a probation period, after which the search switches itself off unless
+// it rejected a large enough share of them. The other checks always stay on.
+//
+// It is safe to call from several threads at once.
+class Prefilter final {
+
+    enum class State : uint8_t {
+        Probation,
+        Enabled,
+        Disabled
+    };
+
+    LengthBounds bounds;
+    EdgeBytes edges;
+    std::vector<std::string> literals;
+
+    mutable std::atomic<State> state = State::Probation;
+    mutable std::atomic<size_t> checked = 0;
+    mutable std::atomic<size_t> rejected = 0;
+
+    [[nodiscard]] bool contains_literal(const char* begin, size_t length) const;
+
+    void record(bool passed) const;
+
+public:
+    // The number of lines of the probation period.
+    static constexpr size_t probation_lines = 4096;
+
+    // A prefilter rejecting fewer than this many of every 16 lines of the probation period is switched off.
+    static constexpr size_t min_rejected_sixteenths = 4;
+
+    // A prefilter for lines within the bounds and edges that contain at least one of the literals, if any are
+    // given. Null if it would not reject any line.
+    [[nodiscard]] static std::shared_ptr<const Prefilter> make(LengthBounds bounds, EdgeBytes edges,
+                                                               std::vector<std::string> literals);
+
+    explicit Prefilter(LengthBounds bounds, EdgeBytes edges, std::vector<std::string> literals);
+
+    // False if the line cannot match. True if it may match, or the literal search is switched off.
+    [[nodiscard]] bool may_match(const char* begin, const size_t length) const {
+
+        if (!bounds.contains(length) || !edges.accepts(begin, length)) {
+            return false;
+        }
+
+        const State current = state.load(std::memory_order_relaxed);
+
+        if (current == State::Disabled) {
+            return true;
+        }
+
+        const bool passed = contains_literal(begin, length);
+        if (current == State::Probation) [[unlikely]] {
+            record(passed);
+        }
+
+        return passed;
+
+    }
+
+};
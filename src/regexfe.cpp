@@ -3,7 +3,11 @@
 #include "Parser.h"
 #include "lexer.hpp"
 
-Expression* parse_regex(const std::string& regex) {
+std::shared_ptr<const Expression> parse_regex(const std::string& regex, const bool optimize) {
+
+    // declared first, so that it outlives the parser and its stack of nodes
+    const auto arena = std::make_shared<AstArena>();
+    const AstArena::Scope scope(*arena);
 
     Lexer lexer(regex);
     Parser parser;
@@ -20,7 +24,7 @@ Expression* parse_regex(const std::string& regex) {
         switch (token.id) {
             case T_CHARACTER:
             case T_SPECIAL_CHARACTER:
-                payload.CHARACTER = token.payload.front();
+                payload.CHARACTER = token.character;
                 break;
 
             default:
@@ -41,6 +45,12 @@ Expression* parse_regex(const std::string& regex) {
         throw ParserError(last_token_position, "invalid syntax.");
     }
 
-    return parser.getValue().expression;
+    Expression* expression = parser.getValue().expression;
+    if (optimize) {
+        expression = expression->optimize(*arena);
+    }
+
+    // shares the ownership of the arena, in which the AST lives
+    return std::shared_ptr<const Expression>(arena, expression);
 
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <exception>
+#include <memory>
 #include <string>
 
 #include "ast.hpp"
@@ -22,4 +23,7 @@ public:
     }
 };
 
-Expression* parse_regex(const std::string& regex);
\ No newline at end of file
+// Parses the regex into an AST, which is optimized, see Expression::optimize, unless told otherwise.
+// The nodes of the AST live in an arena of their own, see AstArena, that the returned pointer owns, so that the
+// whole AST is freed at once with its last owner.
+std::shared_ptr<const Expression> parse_regex(const std::string& regex, bool optimize = true);
\ No newline at end of file
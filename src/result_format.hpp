@@ -0,0 +1,185 @@
+#pragma once
+
+// Layout of the binary result output (--format bitmap or --format indices), and a reader for it.
+// This header is self-contained, so that programs consuming the results can include it on its own.
+//
+// The output is a sequence of frames of exactly result_frame_size bytes, thus frame i starts at
+// i * result_frame_size and the output can be memory-mapped and processed without parsing it first.
+// Every frame consists of a header of result_header_size bytes followed by the payload, padded with zeros.
+// All integers are little-endian.
+//
+//   offset  size  field
+//        0     4  magic "RXRB"
+//        4     2  format version, currently 1
+//        6     1  kind: 1 = bitmap, 2 = indices
+//        7     1  flags: bit 0 is set on the last frame of a file
+//        8     4  file index, i.e. the position of the file among the scanned files, starting at 0
+//       12     4  number of entries in the payload
+//       16     8  index of the first line covered by the frame, lines are counted from 0
+//       24     8  number of lines covered by the frame
+//       32    32  reserved, zero
+//
+// Bitmap frames hold one bit per line, which is set if the line is selected (matches, or does not match with
+// --non-matching). Bit i belongs to line first_line + i and is stored as bit (i % 64) of the 64-bit word i / 64.
+// Indices frames hold the 64-bit indices of the selected lines among the lines covered, in ascending order.
+//
+// Every file ends with a frame with the last flag set, which may have no entries, e.g. for an empty file.
+// The frames of one file appear in line order, while frames of different files may interleave.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+inline constexpr char result_magic[4] = {'R', 'X', 'R', 'B'};
+inline constexpr uint16_t result_format_version = 1;
+
+inline constexpr size_t result_frame_size = 1 << 16;
+inline constexpr size_t result_header_size = 64;
+inline constexpr size_t result_payload_size = result_frame_size - result_header_size;
+
+// capacity of the payload of a single frame
+inline constexpr size_t result_frame_bits = result_payload_size * 8;
+inline constexpr size_t result_frame_indices = result_payload_size / 8;
+
+enum class ResultFrameKind : uint8_t {
+    Bitmap = 1,
+    Indices = 2
+};
+
+inline constexpr uint8_t result_last_frame_flag = 1;
+
+// Little-endian integer encoding, independent of the byte order of the host.
+template<typename T>
+void store_little_endian(unsigned char* destination, const T value) {
+    for (size_t i = 0; i < sizeof(T); i++) {
+        destination[i] = static_cast<unsigned char>(static_cast<uint64_t>(value) >> (8 * i));
+    }
+}
+
+template<typename T>
+T load_little_endian(const unsigned char* source) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        value |= static_cast<uint64_t>(source[i]) << (8 * i);
+    }
+    return static_cast<T>(value);
+}
+
+// The decoded header of a frame.
+struct ResultFrameHeader {
+    ResultFrameKind kind;
+    bool last;
+    uint32_t file_index;
+    uint32_t count;
+    uint64_t first_line;
+    uint64_t line_count;
+};
+
+// A view of a single frame within memory holding the results, e.g. a mapped result file.
+class ResultFrame final {
+
+    const unsigned char* data;
+
+public:
+    // Throws std::runtime_error if data does not start with a valid frame header.
+    // data must point to result_frame_size readable bytes.
+    explicit ResultFrame(const void* data) : data(static_cast<const unsigned char*>(data)) {
+
+        if (std::memcmp(this->data, result_magic, sizeof(result_magic)) != 0) {
+            throw std::runtime_error("invalid result frame: wrong magic");
+        }
+
+        if (load_little_endian<uint16_t>(this->data + 4) != result_format_version) {
+            throw std::runtime_error("invalid result frame: unsupported version");
+        }
+
+        const ResultFrameHeader frame = header();
+
+        if (frame.kind != ResultFrameKind::Bitmap && frame.kind != ResultFrameKind::Indices) {
+            throw std::runtime_error("invalid result frame: unknown kind");
+        }
+
+        const size_t capacity = frame.kind == ResultFrameKind::Bitmap ? result_frame_bits : result_frame_indices;
+
+        if (frame.count > capacity) {
+            throw std::runtime_error("invalid result frame: too many entries");
+        }
+
+    }
+
+    [[nodiscard]] ResultFrameHeader header() const {
+        return ResultFrameHeader{
+            static_cast<ResultFrameKind>(data[6]),
+            (data[7] & result_last_frame_flag) != 0,
+            load_little_endian<uint32_t>(data + 8),
+            load_little_endian<uint32_t>(data + 12),
+            load_little_endian<uint64_t>(data + 16),
+            load_little_endian<uint64_t>(data + 24)
+        };
+    }
+
+    // Bitmap frames: whether the i-th line covered by the frame, i.e. line first_line + i, is selected.
+    [[nodiscard]] bool selected(const size_t i) const {
+        const unsigned char* word = data + result_header_size + i / 64 * 8;
+        return (load_little_endian<uint64_t>(word) >> (i % 64) & 1) != 0;
+    }
+
+    // Indices frames: the i-th selected line, with i < count.
+    [[nodiscard]] uint64_t index(const size_t i) const {
+        return load_little_endian<uint64_t>(data + result_header_size + i * 8);
+    }
+
+    // The raw payload, e.g. to process the bitmap a word at a time.
+    [[nodiscard]] const unsigned char* payload() const {
+        return data + result_header_size;
+    }
+
+};
+
+// ResultReader gives access to the frames of a complete result output held in memory.
+class ResultReader final {
+
+    const unsigned char* data;
+    size_t size;
+
+public:
+    // Throws std::runtime_error if size is not a multiple of the frame size.
+    ResultReader(const void* data, const size_t size) : data(static_cast<const unsigned char*>(data)), size(size) {
+        if (size % result_frame_size != 0) {
+            throw std::runtime_error("invalid result output: incomplete frame");
+        }
+    }
+
+    [[nodiscard]] size_t frame_count() const {
+        return size / result_frame_size;
+    }
+
+    // Throws std::runtime_error if the frame is invalid.
+    [[nodiscard]] ResultFrame frame(const size_t i) const {
+        return ResultFrame(data + i * result_frame_size);
+    }
+
+    // Calls callback(file_index, line_index, selected) for every line of every bitmap frame, and
+    // callback(file_index, line_index, true) for every index of every indices frame, in the order of the output.
+    template<typename Callback>
+    void for_each_result(Callback&& callback) const {
+
+        for (size_t i = 0; i < frame_count(); i++) {
+
+            const ResultFrame result = frame(i);
+            const ResultFrameHeader header = result.header();
+
+            for (uint32_t entry = 0; entry < header.count; entry++) {
+                if (header.kind == ResultFrameKind::Bitmap) {
+                    callback(header.file_index, header.first_line + entry, result.selected(entry));
+                }
+                else {
+                    callback(header.file_index, result.index(entry), true);
+                }
+            }
+        }
+
+    }
+
+};
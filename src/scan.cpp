@@ -0,0 +1,580 @@
+#include "scan.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <charconv>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <utility>
+
+#include "line_assembler.hpp"
+#include "stream_input.hpp"
+
+// large enough to make the scheduling overhead negligible, small enough to keep all workers busy
+static constexpr size_t chunk_size = 2 << 20;
+
+// the number of lines matched with one call, their results fit into a single word
+static constexpr size_t batch_lines = 64;
+
+struct Scanner::ChunkResult {
+
+    StringOutput text;
+    // binary formats: one bit per line, bit i % 64 of bits[i / 64] is set if line i of the chunk is selected
+    std::vector<uint64_t> bits;
+    size_t lines = 0;
+
+    size_t selected = 0;
+    // end of the output of every selected line, only kept if the number of selected lines is limited:
+    // a byte offset into text, or for the binary formats the number of lines up to and including the line
+    std::vector<size_t> selected_ends;
+
+};
+
+struct Scanner::FileScan {
+
+    std::string prefix;
+    std::unique_ptr<InputFile> input;
+    std::vector<InputFile::Chunk> chunks;
+    // number of the first line of every chunk, only counted if line numbers are written
+    std::vector<size_t> first_lines;
+
+    // index of the next chunk to be counted, and the number of chunks whose lines are not yet counted
+    std::atomic<size_t> next_to_count = 0;
+    std::atomic<size_t> uncounted = 0;
+
+    // guards the members below
+    std::mutex mutex;
+    // index of the next chunk to be claimed by a worker, which is less than window chunks after next_to_write,
+    // and the number of claims waiting for next_to_write to move on
+    size_t next_chunk = 0;
+    size_t window = 0;
+    size_t parked = 0;
+    // results of chunks that are complete, but still wait for an earlier chunk: chunk i in slot i % window
+    std::vector<std::optional<ChunkResult>> results;
+    size_t next_to_write = 0;
+    // number of selected lines in the chunks written so far
+    size_t selected = 0;
+    std::optional<FrameEncoder> frames;
+
+};
+
+template<typename Sink>
+static void write_number(Sink& sink, const size_t number) {
+    char digits[20];
+    const char* const end = std::to_chars(digits, digits + sizeof(digits), number).ptr;
+    sink.write(digits, static_cast<size_t>(end - digits));
+}
+
+Scanner::Scanner(const Matcher& matcher, OutputWriter& output, const ScanOptions& options,
+                 const Prefilter* prefilter)
+    : matcher(matcher), prefilter(prefilter), output(output), options(options),
+      limit(options.quiet ? std::min<size_t>(options.max_count, 1) : options.max_count),
+      writes_lines(!options.count && !options.quiet && options.format == OutputFormat::Text),
+      writes_frames(!options.count && !options.quiet && options.format != OutputFormat::Text) {}
+
+void Scanner::report(const InputError& error) {
+    failed = true;
+    std::cerr << error.what() << std::endl;
+}
+
+std::string Scanner::prefix_for(const std::string& file_name) const {
+
+    if (!options.print_file_names) {
+        return "";
+    }
+
+    return (file_name == "-" ? "(standard input)" : file_name) + ":";
+
+}
+
+template<typename Sink>
+bool Scanner::scan_line(Sink& sink, const std::string& prefix, const LineCursor& cursor, const char* line,
+                        const size_t length) {
+
+    const bool matched = (prefilter == nullptr || prefilter->may_match(line, length)) && matcher(line, length);
+    return report_line(sink, prefix, cursor, line, length, matched);
+
+}
+
+template<typename Sink>
+bool Scanner::report_line(Sink& sink, const std::string& prefix, const LineCursor& cursor, const char* line,
+                          const size_t length, const bool matched) {
+
+    const bool selected = matched != (options.selection == Selection::NonMatching);
+
+    if (!writes_lines || (options.selection != Selection::All && !selected)) {
+        return selected;
+    }
+
+    sink.write(prefix);
+
+    switch (options.label) {
+        case LineLabel::Text:
+            sink.write(line, length);
+            break;
+        case LineLabel::Number:
+            write_number(sink, cursor.number);
+            break;
+        case LineLabel::ByteOffset:
+            write_number(sink, cursor.offset);
+            break;
+        default:
+            assert(false);
+    }
+
+    if (options.selection == Selection::All) {
+        sink.write(matched ? ",true" : ",false");
+    }
+
+    sink.end_line();
+    return selected;
+
+}
+
+template<typename LineSource, typename Consumer>
+void Scanner::match_lines(LineSource&& for_each_line, Consumer&& consume) {
+
+    std::array<MatchSpan, batch_lines> lines;
+    size_t count = 0;
+    // the lines the prefilter passes on, and their positions among the lines
+    std::array<MatchSpan, batch_lines> candidates;
+    std::array<uint8_t, batch_lines> positions;
+    size_t candidate_count = 0;
+
+    const auto flush = [&] {
+
+        uint64_t candidate_results = 0;
+        matcher.match_batch(candidates.data(), candidate_count, &candidate_results);
+
+        uint64_t results = 0;
+        for (size_t i = 0; i < candidate_count; i++) {
+            results |= ((candidate_results >> i) & 1) << positions[i];
+        }
+
+        const size_t lines_count = count;
+        count = 0;
+        candidate_count = 0;
+
+        for (size_t i = 0; i < lines_count; i++) {
+            if (!consume(lines[i].begin, lines[i].length, ((results >> i) & 1) != 0)) {
+                return false;
+            }
+        }
+
+        return true;
+
+    };
+
+    bool more = true;
+
+    for_each_line([&](const char* line, const size_t length) {
+        if (prefilter == nullptr || prefilter->may_match(line, length)) {
+            candidates[candidate_count] = MatchSpan{line, length};
+            positions[candidate_count++] = static_cast<uint8_t>(count);
+        }
+        lines[count++] = MatchSpan{line, length};
+        return count < batch_lines || (more = flush());
+    });
+
+    if (more && count > 0) {
+        flush();
+    }
+
+}
+
+std::optional<FrameEncoder> Scanner::frames_for(const uint32_t file_index) const {
+
+    if (!writes_frames) {
+        return std::nullopt;
+    }
+
+    const auto kind = options.format == OutputFormat::Bitmap ? ResultFrameKind::Bitmap : ResultFrameKind::Indices;
+    return FrameEncoder(kind, file_index);
+
+}
+
+template<typename Sink>
+void Scanner::finish_file(Sink& sink, const std::string& prefix, const size_t selected,
+                          std::optional<FrameEncoder>& frames) {
+
+    if (selected > 0) {
+        found = true;
+    }
+
+    if (frames) {
+        frames->finish(sink);
+    }
+
+    if (options.count && !options.quiet) {
+        sink.write(prefix);
+        write_number(sink, selected);
+        sink.end_line();
+    }
+
+}
+
+void Scanner::scan(const std::string& file_name) {
+
+    const uint32_t file_index = next_file_index++;
+
+    if (stopped()) {
+        return;
+    }
+
+    const std::string prefix = prefix_for(file_name);
+
+    try {
+        if (InputStream::is_stream(file_name)) {
+            scan_stream(file_name, prefix, file_index);
+            return;
+        }
+
+        InputFile input(file_name);
+
+        if (const Compression compression = detect_compression(input.contents()); compression != Compression::None) {
+            scan_compressed(input, compression, prefix, file_index);
+            return;
+        }
+
+        LineCursor cursor;
+        size_t selected = 0;
+        std::optional<FrameEncoder> frames = frames_for(file_index);
+
+        if (limit > 0) {
+            match_lines([&](auto&& consumer) { input.for_each_line(consumer); },
+                        [&](const char* line, const size_t length, const bool matched) {
+                const bool line_selected = report_line(output, prefix, cursor, line, length, matched);
+                if (frames) {
+                    frames->add(output, line_selected);
+                }
+                selected += line_selected;
+                cursor.advance(length);
+                return selected < limit;
+            });
+        }
+
+        finish_file(output, prefix, selected, frames);
+    }
+    catch (const InputError& e) {
+        report(e);
+    }
+
+}
+
+void Scanner::scan(const std::string& file_name, ThreadPool& pool) {
+
+    pool.submit([this, file_name, file_index = next_file_index++, &pool] {
+
+        if (stopped()) {
+            return;
+        }
+
+        auto file = std::make_shared<FileScan>();
+        file->prefix = prefix_for(file_name);
+
+        try {
+            if (InputStream::is_stream(file_name)) {
+                scan_stream(file_name, file->prefix, file_index);
+                return;
+            }
+
+            file->input = std::make_unique<InputFile>(file_name);
+        }
+        catch (const InputError& e) {
+            std::lock_guard lock(output_mutex);
+            report(e);
+            return;
+        }
+
+        if (const Compression compression = detect_compression(file->input->contents());
+            compression != Compression::None) {
+            try {
+                scan_compressed(*file->input, compression, file->prefix, file_index);
+            }
+            catch (const InputError& e) {
+                std::lock_guard lock(output_mutex);
+                report(e);
+            }
+            return;
+        }
+
+        file->chunks = file->input->split_lines(chunk_size);
+        // the results of at most this many chunks are held in memory at the same time
+        file->window = std::min(file->chunks.size(), 2 * pool.size());
+        file->results.resize(file->window);
+        file->frames = frames_for(file_index);
+
+        if (file->chunks.empty() || limit == 0) {
+            std::lock_guard lock(output_mutex);
+            finish_file(output, file->prefix, 0, file->frames);
+            return;
+        }
+
+        if (options.label == LineLabel::Number && file->chunks.size() > 1) {
+            file->first_lines.resize(file->chunks.size());
+            file->uncounted = file->chunks.size();
+            count_lines(file, pool);
+            return;
+        }
+
+        scan_chunks(file, pool);
+    });
+
+}
+
+void Scanner::count_lines(const std::shared_ptr<FileScan>& file, ThreadPool& pool) {
+
+    const size_t index = file->next_to_count.fetch_add(1);
+
+    if (index >= file->chunks.size()) {
+        return;
+    }
+
+    if (index + 1 < file->chunks.size()) {
+        pool.submit([this, file, &pool] { count_lines(file, pool); });
+    }
+
+    const std::string_view contents = file->input->contents();
+    const InputFile::Chunk chunk = file->chunks[index];
+    file->first_lines[index] = std::count(contents.begin() + chunk.begin, contents.begin() + chunk.end, '\n');
+
+    // the last chunk to be counted turns the counts into line numbers and starts matching
+    if (file->uncounted.fetch_sub(1) == 1) {
+
+        size_t number = 1;
+
+        for (size_t& first_line : file->first_lines) {
+            const size_t lines = first_line;
+            first_line = number;
+            number += lines;
+        }
+
+        scan_chunks(file, pool);
+    }
+
+}
+
+void Scanner::scan_chunks(const std::shared_ptr<FileScan>& file, ThreadPool& pool) {
+
+    size_t index;
+    {
+        std::lock_guard lock(file->mutex);
+
+        if (file->next_chunk >= file->chunks.size()) {
+            return;
+        }
+
+        // the results of the chunk would have no slot yet, complete_chunk makes the claim again
+        if (file->next_chunk >= file->next_to_write + file->window) {
+            file->parked++;
+            return;
+        }
+
+        index = file->next_chunk++;
+    }
+
+    // offer the remaining chunks to the other workers before working on this one
+    if (index + 1 < file->chunks.size()) {
+        pool.submit([this, file, &pool] { scan_chunks(file, pool); });
+    }
+
+    ChunkResult result;
+    const InputFile::Chunk chunk = file->chunks[index];
+    LineCursor cursor{file->first_lines.empty() ? 1 : file->first_lines[index], chunk.begin};
+    const bool limited = limit != std::numeric_limits<size_t>::max();
+
+    if (!stopped()) {
+        // an earlier chunk may reach the limit as well, in which case this chunk is not written at all
+        match_lines([&](auto&& consumer) { file->input->for_each_line(chunk, consumer); },
+                    [&](const char* line, const size_t length, const bool matched) {
+            const bool selected = report_line(result.text, file->prefix, cursor, line, length, matched);
+            if (writes_frames) {
+                if (result.lines % 64 == 0) {
+                    result.bits.push_back(0);
+                }
+                result.bits.back() |= static_cast<uint64_t>(selected) << (result.lines % 64);
+            }
+            result.lines++;
+            if (selected) {
+                result.selected++;
+                if (limited) {
+                    result.selected_ends.push_back(writes_frames ? result.lines : result.text.size());
+                }
+            }
+            cursor.advance(length);
+            return result.selected < limit && !stopped();
+        });
+    }
+
+    if (result.selected > 0) {
+        found = true;
+    }
+
+    // resume the claims that waited for the chunks written now
+    for (size_t resumed = complete_chunk(*file, index, std::move(result)); resumed > 0; resumed--) {
+        pool.submit([this, file, &pool] { scan_chunks(file, pool); });
+    }
+
+}
+
+size_t Scanner::complete_chunk(FileScan& file, const size_t index, ChunkResult&& result) {
+
+    std::lock_guard file_lock(file.mutex);
+
+    file.results[index % file.window] = std::move(result);
+
+    if (index != file.next_to_write) {
+        return 0;
+    }
+
+    std::lock_guard output_lock(output_mutex);
+
+    while (file.next_to_write < file.chunks.size() && file.results[file.next_to_write % file.window]) {
+
+        std::optional<ChunkResult>& slot = file.results[file.next_to_write % file.window];
+        const ChunkResult& chunk = *slot;
+        const size_t remaining = limit - file.selected;
+        const bool reached = chunk.selected >= remaining;
+
+        std::string_view text = chunk.text.view();
+        size_t lines = chunk.lines;
+        if (reached && writes_frames) {
+            lines = chunk.selected_ends[remaining - 1];
+        }
+        else if (reached) {
+            text = text.substr(0, chunk.selected_ends[remaining - 1]);
+        }
+
+        output.write(text);
+        if (file.frames) {
+            file.frames->append(output, chunk.bits, lines);
+        }
+        file.selected += reached ? remaining : chunk.selected;
+        slot.reset();
+        file.next_to_write++;
+
+        if (output.is_line_buffered()) {
+            output.flush();
+        }
+
+        if (reached) {
+            // stop claiming chunks, the results of those still in progress are dropped
+            file.next_chunk = file.chunks.size();
+            file.next_to_write = file.chunks.size();
+            finish_file(output, file.prefix, file.selected, file.frames);
+            return 0;
+        }
+    }
+
+    if (file.next_to_write == file.chunks.size()) {
+        finish_file(output, file.prefix, file.selected, file.frames);
+    }
+
+    return std::exchange(file.parked, 0);
+
+}
+
+template<typename LineSource>
+void Scanner::scan_lines(const std::string& prefix, const uint32_t file_index, LineSource&& for_each_line) {
+
+    // results are handed to the output in large pieces, as other files may be scanned concurrently
+    StringOutput results;
+    LineCursor cursor;
+    size_t selected = 0;
+    std::optional<FrameEncoder> frames = frames_for(file_index);
+
+    const auto write_results = [&] {
+        std::lock_guard lock(output_mutex);
+        output.write(results.view());
+        results.clear();
+        if (output.is_line_buffered()) {
+            output.flush();
+        }
+    };
+
+    try {
+        if (limit > 0) {
+            for_each_line([&](const char* line, const size_t length) {
+                const bool line_selected = scan_line(results, prefix, cursor, line, length);
+                if (frames) {
+                    frames->add(results, line_selected);
+                }
+                selected += line_selected;
+                cursor.advance(length);
+                if (results.size() >= BlockStream::block_capacity || output.is_line_buffered()) {
+                    write_results();
+                }
+                return selected < limit && !stopped();
+            });
+        }
+    }
+    catch (const InputError&) {
+        // keep the results of everything read before the error
+        write_results();
+        throw;
+    }
+
+    finish_file(results, prefix, selected, frames);
+    write_results();
+
+}
+
+void Scanner::scan_compressed(const InputFile& input, const Compression compression, const std::string& prefix,
+                              const uint32_t file_index) {
+
+    BlockStream stream;
+    stream.start([&input, compression](BlockStream& blocks) { decompress(compression, input.contents(), blocks); });
+
+    scan_lines(prefix, file_index, [&](auto&& consumer) { stream.for_each_line(consumer); });
+
+}
+
+void Scanner::scan_stream(const std::string& file_name, const std::string& prefix, const uint32_t file_index) {
+
+    const InputStream input(file_name);
+
+    scan_lines(prefix, file_index, [&](auto&& consumer) {
+        LineAssembler lines;
+        bool more = true;
+        input.read([&](char* data, const size_t size) { return more = lines.feed(data, size, consumer); });
+        if (more) {
+            lines.finish(consumer);
+        }
+    });
+
+}
+
+std::vector<std::string> expand_paths(const std::vector<std::string>& paths) {
+
+    namespace fs = std::filesystem;
+
+    std::vector<std::string> file_names;
+
+    for (const std::string& path : paths) {
+
+        std::error_code error;
+
+        if (!fs::is_directory(path, error)) {
+            file_names.push_back(path);
+            continue;
+        }
+
+        std::vector<std::string> directory_files;
+
+        for (auto it = fs::recursive_directory_iterator(path, fs::directory_options::skip_permission_denied, error);
+             !error && it != fs::recursive_directory_iterator();
+             it.increment(error)) {
+            if (it->is_regular_file(error)) {
+                directory_files.push_back(it->path().string());
+            }
+        }
+
+        std::sort(directory_files.begin(), directory_files.end());
+        file_names.insert(file_names.end(), directory_files.begin(), directory_files.end());
+    }
+
+    return file_names;
+
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "decompress.hpp"
+#include "frame_encoder.hpp"
+#include "input.hpp"
+#include "matcher.hpp"
+#include "output.hpp"
+#include "prefilter.hpp"
+#include "thread_pool.hpp"
+
+// Which lines are reported. A line is selected if it matches, or, with NonMatching, if it does not match.
+enum class Selection {
+    // every line, followed by ",true" or ",false"
+    All,
+    Matching,
+    NonMatching
+};
+
+// How a reported line is shown.
+enum class LineLabel {
+    Text,
+    // the number of the line, starting at 1
+    Number,
+    // the offset of the first byte of the line, starting at 0
+    ByteOffset
+};
+
+enum class OutputFormat {
+    Text,
+    // binary frames as described in result_format.hpp, with one bit per line
+    Bitmap,
+    // binary frames as described in result_format.hpp, with the indices of the selected lines
+    Indices
+};
+
+struct ScanOptions {
+    // If set, every result line is prefixed with "<file_name>:", or with "(standard input):" for the file name "-".
+    bool print_file_names = false;
+    Selection selection = Selection::All;
+    LineLabel label = LineLabel::Text;
+    OutputFormat format = OutputFormat::Text;
+    // Writes only the number of selected lines of every file.
+    bool count = false;
+    // Writes nothing and stops scanning, all files, at the first selected line.
+    bool quiet = false;
+    // Stops reading a file once this many lines are selected.
+    size_t max_count = std::numeric_limits<size_t>::max();
+};
+
+// Scanner matches every line of its input files against a compiled regex and writes the results.
+//
+// Files can be scanned one after another on the calling thread, or be handed to a ThreadPool.
+// Compressed files are detected by their magic bytes and decompressed on a separate thread, concurrently
+// with matching the lines decompressed so far. The standard input ("-"), FIFOs, sockets and devices are
+// read as streams, the lines are matched as soon as they arrive.
+//
+// On the pool, every uncompressed file is split into chunks of complete lines, which are claimed one by one
+// by whichever worker gets to them first. No chunk is claimed more than two per worker ahead of the first chunk
+// whose results are not written yet, which bounds the results held in memory. The results of every file are
+// written in the original line order, while the results of different files may interleave at chunk granularity.
+// Line numbers need the number of lines before every chunk, which are counted in parallel before matching starts.
+//
+// With a Prefilter, lines that cannot match, e.g. because of their length, are not passed to the matcher at all.
+// The lines of files that are read at once are matched in batches, see Matcher::match_batch, while streamed
+// lines are matched one by one, as soon as they arrive.
+//
+// Unless every line is reported, the output is written only for selected lines, and when counting or quiet
+// it is not formatted at all. With a maximum count, a file is read only until that many lines are selected.
+// The binary formats write no text at all, chunks on the pool keep one bit per line, which are merged
+// into the frames of the file in line order.
+class Scanner final {
+
+    struct FileScan;
+    struct ChunkResult;
+
+    // position of a line in its file
+    struct LineCursor {
+        size_t number = 1;
+        size_t offset = 0;
+
+        void advance(const size_t length) {
+            number++;
+            offset += length + 1;
+        }
+    };
+
+    const Matcher& matcher;
+    const Prefilter* const prefilter;
+    OutputWriter& output;
+    const ScanOptions options;
+    // number of selected lines after which a file is not read any further
+    const size_t limit;
+    const bool writes_lines;
+    const bool writes_frames;
+
+    // position of the next file among the scanned files, as written to binary frames
+    uint32_t next_file_index = 0;
+
+    // guards output and std::cerr while scanning on a pool
+    std::mutex output_mutex;
+    std::atomic<bool> failed = false;
+    std::atomic<bool> found = false;
+
+    void report(const InputError& error);
+
+    [[nodiscard]] std::string prefix_for(const std::string& file_name) const;
+
+    // True if nothing needs to be read anymore, as a line is selected in quiet mode.
+    [[nodiscard]] bool stopped() const {
+        return options.quiet && found.load(std::memory_order_relaxed);
+    }
+
+    // Matches a single line and writes its result to sink, which is either an OutputWriter or a StringOutput.
+    // Returns true if the line is selected.
+    template<typename Sink>
+    bool scan_line(Sink& sink, const std::string& prefix, const LineCursor& cursor, const char* line, size_t length);
+
+    // Writes the result of a line that has been matched to sink and returns true if the line is selected.
+    template<typename Sink>
+    bool report_line(Sink& sink, const std::string& prefix, const LineCursor& cursor, const char* line,
+                     size_t length, bool matched);
+
+    // Matches the lines passed by for_each_line(consumer) in batches, and passes each line with its result to
+    // consume(line, length, matched) in order, until it returns false. The lines must stay valid until then.
+    template<typename LineSource, typename Consumer>
+    void match_lines(LineSource&& for_each_line, Consumer&& consume);
+
+    [[nodiscard]] std::optional<FrameEncoder> frames_for(uint32_t file_index) const;
+
+    // Writes the count or the last frame of a completely scanned file, if requested.
+    template<typename Sink>
+    void finish_file(Sink& sink, const std::string& prefix, size_t selected, std::optional<FrameEncoder>& frames);
+
+    void count_lines(const std::shared_ptr<FileScan>& file, ThreadPool& pool);
+    void scan_chunks(const std::shared_ptr<FileScan>& file, ThreadPool& pool);
+    // Stores the results of the chunk and writes those that are next in line.
+    // Returns the number of parked claims of chunks to resume, as the window of chunks in flight moved on.
+    size_t complete_chunk(FileScan& file, size_t index, ChunkResult&& result);
+
+    // Compressed files and streams are scanned on the calling thread, while their input is produced.
+    void scan_compressed(const InputFile& input, Compression compression, const std::string& prefix,
+                         uint32_t file_index);
+    void scan_stream(const std::string& file_name, const std::string& prefix, uint32_t file_index);
+
+    // Matches the lines passed by for_each_line(consumer) and writes the results in large pieces.
+    template<typename LineSource>
+    void scan_lines(const std::string& prefix, uint32_t file_index, LineSource&& for_each_line);
+
+public:
+    // The prefilter, if any, must outlive the Scanner.
+    explicit Scanner(const Matcher& matcher, OutputWriter& output, const ScanOptions& options,
+                     const Prefilter* prefilter = nullptr);
+
+    // Scans the file on the calling thread.
+    void scan(const std::string& file_name);
+
+    // Schedules the file to be scanned on the pool. Call pool.wait_idle() to wait for all scheduled files.
+    // The Scanner must outlive the scan.
+    void scan(const std::string& file_name, ThreadPool& pool);
+
+    // True if some input file could not be read. The errors have been reported on std::cerr.
+    [[nodiscard]] bool had_errors() const {
+        return failed;
+    }
+
+    // True if a line has been selected in any file.
+    [[nodiscard]] bool found_any() const {
+        return found;
+    }
+
+};
+
+// Replaces every directory among the paths with the regular files below it, recursively and sorted by name.
+// Other paths are kept as they are.
+std::vector<std::string> expand_paths(const std::vector<std::string>& paths);
@@ -0,0 +1,304 @@
+#include "stream_input.hpp"
+
+#include <cerrno>
+#include <memory>
+
+#include "block_stream.hpp"
+#include "input.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#ifdef REGEXFE_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+static InputError read_error() {
+    return InputError("0: error: failed to read input.");
+}
+
+// Blocks until a non-blocking file has data, only needed if our caller handed us such a file.
+static void wait_readable([[maybe_unused]] const int fd) {
+#ifndef _WIN32
+    pollfd poll_fd{fd, POLLIN, 0};
+    while (::poll(&poll_fd, 1, -1) < 0 && errno == EINTR) {}
+#endif
+}
+
+static size_t read_some(const int fd, char* data, const size_t capacity) {
+
+    while (true) {
+
+#ifndef _WIN32
+        const ssize_t n = ::read(fd, data, capacity);
+#else
+        const int n = ::_read(fd, data, static_cast<unsigned int>(capacity));
+#endif
+
+        if (n >= 0) {
+            return static_cast<size_t>(n);
+        }
+
+        if (errno == EAGAIN) {
+            wait_readable(fd);
+        }
+        else if (errno != EINTR) {
+            throw read_error();
+        }
+    }
+
+}
+
+// Lets the consumer wake up the read-ahead thread when it stops reading, as the thread may be waiting
+// for input that is never going to arrive, e.g. from an idle pipe.
+class StopSignal final {
+
+#ifndef _WIN32
+    int pipe_fds[2] = {-1, -1};
+#endif
+
+public:
+    StopSignal() {
+#ifndef _WIN32
+        if (::pipe(pipe_fds) != 0) {
+            throw read_error();
+        }
+#endif
+    }
+
+    StopSignal(const StopSignal&) = delete;
+    StopSignal& operator=(const StopSignal&) = delete;
+
+    ~StopSignal() {
+#ifndef _WIN32
+        ::close(pipe_fds[0]);
+        ::close(pipe_fds[1]);
+#endif
+    }
+
+    void raise() const {
+#ifndef _WIN32
+        constexpr char byte = 0;
+        [[maybe_unused]] const ssize_t written = ::write(pipe_fds[1], &byte, 1);
+#endif
+    }
+
+    // Blocks until fd has data, or until the signal is raised. Returns false in the latter case.
+    bool wait_readable([[maybe_unused]] const int fd) const {
+#ifndef _WIN32
+        pollfd poll_fds[2] = {{fd, POLLIN, 0}, {pipe_fds[0], POLLIN, 0}};
+        while (::poll(poll_fds, 2, -1) < 0) {
+            if (errno != EINTR) {
+                throw read_error();
+            }
+        }
+        return poll_fds[1].revents == 0;
+#else
+        return true;
+#endif
+    }
+
+};
+
+static void read_with_thread(const int fd, const std::function<bool(char*, size_t)>& on_block) {
+
+    const StopSignal stop;
+    BlockStream stream;
+
+    stream.start([fd, &stop](BlockStream& blocks) {
+        while (stop.wait_readable(fd)) {
+
+            Block block = blocks.acquire();
+            block.size = read_some(fd, block.data.get(), BlockStream::block_capacity);
+
+            // hand out whatever has arrived, so that interactive input is not held back
+            if (block.size == 0 || !blocks.publish(std::move(block))) {
+                return;
+            }
+        }
+    });
+
+    // the stream waits for the thread when it is destroyed, so wake the thread up first
+    try {
+        stream.for_each_block(on_block);
+    }
+    catch (...) {
+        stop.raise();
+        throw;
+    }
+
+    stop.raise();
+
+}
+
+#ifdef REGEXFE_HAVE_LIBURING
+
+// Returns false, without reading anything, if io_uring is not available,
+// e.g. on kernels older than 5.6 or if it is disabled by a seccomp policy.
+static bool read_with_uring(const int fd, const std::function<bool(char*, size_t)>& on_block) {
+
+    io_uring ring{};
+
+    if (io_uring_queue_init(2, &ring, 0) < 0) {
+        return false;
+    }
+
+    // reads at the current file position, as pipes and sockets require
+    if (!(ring.features & IORING_FEAT_RW_CUR_POS)) {
+        io_uring_queue_exit(&ring);
+        return false;
+    }
+
+    constexpr size_t block_capacity = BlockStream::block_capacity;
+
+    // one buffer is being processed while the kernel fills the other one
+    const std::unique_ptr<char[]> buffers[2] = {
+        std::make_unique<char[]>(block_capacity),
+        std::make_unique<char[]>(block_capacity)
+    };
+
+    // index of the buffer with a read in flight, or -1
+    int pending = -1;
+
+    // a read still in flight when leaving must be cancelled and completed before its buffer is freed
+    struct RingGuard {
+        io_uring& ring;
+        const int& pending;
+
+        ~RingGuard() {
+            if (pending >= 0) {
+                io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+                io_uring_prep_cancel(sqe, nullptr, 0);
+                io_uring_submit(&ring);
+                // one completion for the read, one for the cancellation
+                for (int i = 0; i < 2; i++) {
+                    io_uring_cqe* cqe;
+                    while (io_uring_wait_cqe(&ring, &cqe) == -EINTR) {}
+                    io_uring_cqe_seen(&ring, cqe);
+                }
+            }
+            io_uring_queue_exit(&ring);
+        }
+    } guard{ring, pending};
+
+    const auto submit = [&](const int index) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_read(sqe, fd, buffers[index].get(), block_capacity, static_cast<__u64>(-1));
+        io_uring_sqe_set_data(sqe, nullptr);
+        io_uring_submit(&ring);
+        pending = index;
+    };
+
+    const auto wait = [&] {
+        io_uring_cqe* cqe;
+        int error;
+        while ((error = io_uring_wait_cqe(&ring, &cqe)) == -EINTR) {}
+        if (error < 0) {
+            throw read_error();
+        }
+        const int result = cqe->res;
+        io_uring_cqe_seen(&ring, cqe);
+        pending = -1;
+        return result;
+    };
+
+    int current = 0;
+    submit(current);
+
+    while (true) {
+
+        const int result = wait();
+
+        if (result == -EINTR || result == -EAGAIN) {
+            if (result == -EAGAIN) {
+                wait_readable(fd);
+            }
+            submit(current);
+            continue;
+        }
+
+        if (result < 0) {
+            throw read_error();
+        }
+
+        if (result == 0) {
+            return true;
+        }
+
+        // start reading the next block before processing this one
+        submit(1 - current);
+        if (!on_block(buffers[current].get(), static_cast<size_t>(result))) {
+            return true;
+        }
+        current = 1 - current;
+    }
+
+}
+
+#endif
+
+InputStream::InputStream(const std::string& file_name) {
+
+    if (file_name == "-") {
+        fd = 0;
+        owned = false;
+        return;
+    }
+
+#ifndef _WIN32
+    fd = ::open(file_name.c_str(), O_RDONLY);
+#else
+    fd = ::_open(file_name.c_str(), _O_RDONLY | _O_BINARY);
+#endif
+
+    if (fd < 0) {
+        throw InputError("0: error: could not open file '" + file_name + "' for reading.");
+    }
+
+    owned = true;
+
+}
+
+InputStream::~InputStream() {
+    if (owned) {
+#ifndef _WIN32
+        ::close(fd);
+#else
+        ::_close(fd);
+#endif
+    }
+}
+
+bool InputStream::is_stream(const std::string& file_name) {
+
+    if (file_name == "-") {
+        return true;
+    }
+
+#ifndef _WIN32
+    struct stat st {};
+    return ::stat(file_name.c_str(), &st) == 0 && !S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode);
+#else
+    return false;
+#endif
+
+}
+
+void InputStream::read(const std::function<bool(char* data, size_t size)>& on_block) const {
+
+#ifdef REGEXFE_HAVE_LIBURING
+    if (read_with_uring(fd, on_block)) {
+        return;
+    }
+#endif
+
+    read_with_thread(fd, on_block);
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+// InputStream reads an input that cannot be memory-mapped, such as the standard input, a FIFO or a socket,
+// in blocks as the data arrives, instead of waiting for the end of the input.
+//
+// Reading the next block overlaps with processing the current one: with io_uring where the kernel supports it,
+// otherwise with a read-ahead thread. Either way the processing never waits for a read system call
+// unless the data has not arrived yet.
+class InputStream final {
+
+    int fd;
+    bool owned;
+
+public:
+    // The file name "-" denotes the standard input. Throws InputError if the file cannot be opened.
+    explicit InputStream(const std::string& file_name);
+
+    InputStream(const InputStream&) = delete;
+    InputStream& operator=(const InputStream&) = delete;
+
+    ~InputStream();
+
+    // True if the file is to be read through an InputStream rather than an InputFile.
+    static bool is_stream(const std::string& file_name);
+
+    // Reads until the end of the input and calls on_block(data, size) for every block, in order.
+    // The block may be modified in place. Reading stops early if on_block returns false, even if the input
+    // is waiting for more data at that moment. Throws InputError if reading fails.
+    void read(const std::function<bool(char* data, size_t size)>& on_block) const;
+
+};
@@ -3,14 +3,51 @@
  * (With some modifications by Alexander Mayorov)
  **/
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "Parser.h"
 #include "ast.hpp"
+#include "block_stream.hpp"
+#include "compile_service.hpp"
+#include "decompress.hpp"
+#include "dfa_table.hpp"
+#include "fast_path.hpp"
+#include "frame_encoder.hpp"
+#include "input.hpp"
+#include "lazy_dfa.hpp"
 #include "lexer.hpp"
+#include "line_assembler.hpp"
+#include "output.hpp"
+#include "prefilter.hpp"
 #include "regexfe.hpp"
+#include "result_format.hpp"
+#include "scan.hpp"
+
+#ifdef REGEXFE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef REGEXFE_HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 struct TestCase {
     std::string regex;
@@ -18,95 +55,1460 @@ struct TestCase {
     std::string description;
 };
 
-struct TestResult {
-    int passed = 0;
-    int total = 0;
-    std::vector<std::string> failures;
+struct MatchCase {
+    std::string regex;
+    std::string input;
+    bool should_match;
+    std::string description;
+};
+
+// A span of the first length bytes of the buffer, which goes on after the span
+struct SpanCase {
+    std::string regex;
+    std::string buffer;
+    size_t length;
+    bool should_match;
+    std::string description;
+};
+
+// count lines of up to max_length bytes drawn from the alphabet, matched as one batch by a lazy DFA whose cache
+// holds cache_bytes
+struct BatchCase {
+    std::string regex;
+    std::string alphabet;
+    size_t count;
+    size_t max_length;
+    size_t cache_bytes;
+    std::string description;
+};
+
+// count patterns "p<i>x[a-z]*", each compiled by every one of services services of workers workers, which all run
+// at the same time
+struct CompileCase {
+    size_t count;
+    size_t services;
+    size_t workers;
+    MimirCodeGen::Backend backend;
+    std::string description;
+};
+
+struct LiteralCase {
+    std::string regex;
+    std::vector<std::string> literals;
+    std::string description;
+};
+
+struct LengthCase {
+    std::string regex;
+    size_t min;
+    size_t max;
+    std::string description;
+};
+
+struct OptimizeCase {
+    std::string regex;
+    std::string optimized;
+    std::string description;
+};
+
+// Every input of up to max_length bytes of the alphabet, which the original and the optimized regex must both match
+// or both reject
+struct EquivalenceCase {
+    std::string regex;
+    std::string alphabet;
+    size_t max_length;
+    std::string description;
+};
+
+// Members compressed one by one and concatenated, which the decompressor must give back unchanged
+struct DecompressCase {
+    Compression compression;
+    std::vector<std::string> members;
+    std::string description;
+};
+
+// The results of line_count lines, every every-th of which is selected, added one at a time or in chunks
+struct FrameCase {
+    ResultFrameKind kind;
+    size_t line_count;
+    size_t every;
+    bool bulk;
+    std::string description;
+};
+
+// Lines of line_length bytes, count of them, written through an OutputWriter into a file
+struct OutputCase {
+    size_t line_length;
+    size_t count;
+    bool line_buffered;
+    std::string description;
+};
+
+// Files of sample lines, one per entry of file_lines, in a tree of directories, but the last one outside of it,
+// scanned on a pool of the given number of threads, or on the calling thread for 0
+struct TreeCase {
+    std::vector<size_t> file_lines;
+    size_t threads;
+    std::string description;
+};
+
+// The input fed to a LineAssembler in pieces of the given sizes, cycling through them, until stop_after lines are
+// handed out
+struct AssemblyCase {
+    std::string input;
+    std::vector<size_t> piece_sizes;
+    size_t stop_after;
+    std::string description;
+};
+
+// A file scanned for the lines matching the regex with the options, which must write the output, and find a line
+// or not
+struct ScanModeCase {
+    std::string regex;
+    std::string input;
+    ScanOptions options;
+    std::string output;
+    bool found;
+    std::string description;
+};
+
+// A regex compiled by each backend, whose matchers must both give the results of the Pike VM on the inputs
+struct BackendCase {
+    std::string regex;
+    std::vector<std::string> inputs;
+    std::string description;
+};
+
+// Code generation options, see CodeGenOptions, which must be accepted or rejected, be passed to clang as the flags,
+// and compile a matcher with clang or fail to
+struct CodeGenCase {
+    int opt_level;
+    std::string march;
+    std::string mtune;
+    bool bitcode;
+    bool valid;
+    std::string flags;
+    bool compiles;
+    std::string description;
+};
+
+// A regex of a single set of bytes, which must be the ranges, as few as possible in ascending order
+struct ByteSetCase {
+    std::string regex;
+    std::vector<std::pair<unsigned char, unsigned char>> ranges;
+    std::string description;
+};
+
+// A regex parsed on a thread of its own, optimized or not, whose AST must still match the input after other parses
+struct ArenaCase {
+    std::string regex;
+    bool optimize;
+    std::string input;
+    bool should_match;
+    std::string description;
+};
+
+// A regex lexed in place, which must give the tokens up to T_EOF, or these tokens and then an error at the position
+struct LexCase {
+    std::string regex;
+    std::vector<Token> tokens;
+    std::optional<size_t> error_position;
+    std::string description;
+};
+
+struct TestResult {
+    int passed = 0;
+    int total = 0;
+    std::vector<std::string> failures;
+};
+
+// Prints the banner of the section and runs test(test_case, result) for each of its cases
+template<typename Case>
+void run_section(const std::string& section_name, const std::vector<std::type_identity_t<Case>>& cases,
+                 void (*test)(const Case&, TestResult&), TestResult& result) {
+    std::cout << "\n╔════════════════════════════════════════════════════════════════╗\n";
+    std::cout << "║ " << std::left << std::setw(62) << section_name << "║\n";
+    std::cout << "╚════════════════════════════════════════════════════════════════╝\n";
+
+    for (const auto& test_case : cases) {
+        test(test_case, result);
+    }
+}
+
+// The parts of the report every test shares: its first line, and its status once it is decided
+
+void begin_test(const std::string& description, TestResult& result) {
+    std::cout << "\n  ┌─ Test: " << description << "\n";
+    result.total++;
+}
+
+void pass_test(TestResult& result) {
+    std::cout << "  └─ Status: PASS\n";
+    result.passed++;
+}
+
+void fail_test(const std::string& outcome, const std::string& failure, TestResult& result) {
+    std::cout << "  │ Result: ❌ " << outcome << "\n";
+    std::cout << "  └─ Status: FAIL\n";
+    result.failures.push_back(failure);
+}
+
+// Parses the regex of a test that expects it to be valid, fails the test and returns nullptr if it is not
+std::shared_ptr<const Expression> parse_test_regex(const std::string& regex, const std::string& description,
+                                                   TestResult& result, const bool optimize = true) {
+    try {
+        return parse_regex(regex, optimize);
+    }
+    catch (...) {
+        fail_test("PARSE ERROR", description + ": \"" + regex + "\" (parse error)", result);
+        return nullptr;
+    }
+}
+
+// Always show MimIR for successful parses
+void test_regex(const std::string& regex, bool should_fail, const std::string& description, TestResult& result) {
+    std::cout << "\n  ┌─ Test: " << description << "\n";
+    std::cout << "  │ Regex: \"" << regex << "\"\n";
+    std::cout << "  │ Expect: " << (should_fail ? "FAIL" : "PASS") << "\n";
+
+    result.total++;
+
+    std::shared_ptr<const Expression> expression;
+
+    try {
+        expression = parse_regex(regex);
+    }
+    catch (const LexerError& e) {
+        if (should_fail) {
+            std::cout << "  │ Result: ✅ EXPECTED ERROR\n";
+            std::cout << "  │ Error: " << e << "\n";
+            std::cout << "  └─ Status: PASS\n";
+            result.passed++;
+        }
+        else {
+            std::cout << "  │ Result: ❌ UNEXPECTED ERROR\n";
+            std::cout << "  │ Error: " << e << "\n";
+            std::cout << "  └─ Status: FAIL\n";
+            result.failures.push_back(description + ": \"" + regex + "\" (unexpected error)");
+        }
+        return;
+    }
+    catch (const ParserError& e) {
+        if (should_fail) {
+            std::cout << "  │ Result: ✅ EXPECTED ERROR\n";
+            std::cout << "  │ Error: " << e << "\n";
+            std::cout << "  └─ Status: PASS\n";
+            result.passed++;
+        }
+        else {
+            std::cout << "  │ Result: ❌ UNEXPECTED ERROR\n";
+            std::cout << "  │ Error: " << e << "\n";
+            std::cout << "  └─ Status: FAIL\n";
+            result.failures.push_back(description + ": \"" + regex + "\" (unexpected error)");
+        }
+        return;
+    }
+    catch (...) {
+        std::cout << "  │ Result: ❌ UNKNOWN EXCEPTION\n";
+        std::cout << "  └─ Status: FAIL\n";
+        result.failures.push_back(description + ": \"" + regex + "\" (unknown exception)");
+        return;
+    }
+
+    if (should_fail) {
+        std::cout << "  │ Result: ❌ UNEXPECTED SUCCESS\n";
+        std::cout << "  └─ Status: FAIL\n";
+        result.failures.push_back(description + ": \"" + regex + "\" (should have failed)");
+        return;
+    }
+
+    MimirCodeGen code_gen;
+    MimRegex mim_result = expression->generateMimIR(code_gen);
+
+    // Show MimIR output
+    std::ostringstream oss;
+    oss << mim_result;
+    std::string mimir_str = oss.str();
+
+    // Clean up newlines
+    std::erase(mimir_str, '\n');
+
+    std::cout << "  │ Result: ✅ SUCCESS\n";
+    std::cout << "  │ MimIR: " << mimir_str << "\n";
+    std::cout << "  └─ Status: PASS\n";
+    result.passed++;
+
+}
+
+void run_test_section(const std::string& section_name, const std::vector<TestCase>& tests, TestResult& result) {
+    std::cout << "\n╔════════════════════════════════════════════════════════════════╗\n";
+    std::cout << "║ " << std::left << std::setw(62) << section_name << "║\n";
+    std::cout << "╚════════════════════════════════════════════════════════════════╝\n";
+
+    for (const auto& test : tests) {
+        test_regex(test.regex, test.should_fail, test.description, result);
+    }
+}
+
+// Matches the whole input with the Pike VM, also for the optimized regex, the lazy DFA and, for trivial shapes, the
+// fast path, which need no MimIR and no compiler
+void test_match(const MatchCase& test, TestResult& result) {
+    begin_test(test.description, result);
+    std::cout << "  │ Regex: \"" << test.regex << "\"  Input: \"" << test.input << "\"\n";
+    std::cout << "  │ Expect: " << (test.should_match ? "MATCH" : "NO MATCH") << "\n";
+
+    const std::shared_ptr<const Expression> expression = parse_test_regex(test.regex, test.description, result, false);
+    const std::shared_ptr<const Expression> optimized_expression =
+        expression ? parse_test_regex(test.regex, test.description, result) : nullptr;
+    if (!optimized_expression) {
+        return;
+    }
+
+    const PikeProgram program = expression->generatePikeProgram();
+    const PikeProgram optimized = optimized_expression->generatePikeProgram();
+    const LazyDfa dfa(program);
+    const std::optional<std::vector<ShapePiece>> shape = expression->shape();
+    const std::shared_ptr<const FastPath> fast_path = shape ? FastPath::classify(*shape) : nullptr;
+
+    std::vector<std::pair<std::string, const MatchEngine*>> engines = {
+        {"Pike VM", &program}, {"optimized Pike VM", &optimized}, {"lazy DFA", &dfa}};
+    if (fast_path) {
+        engines.emplace_back("fast path", fast_path.get());
+    }
+
+    for (const auto& [name, engine] : engines) {
+        if (engine->matches(test.input.data(), test.input.size()) != test.should_match) {
+            fail_test(std::string(test.should_match ? "NO MATCH" : "MATCH") + " (" + name + ")",
+                      test.description + ": \"" + test.regex + "\" on \"" + test.input + "\" (" + name + ")", result);
+            return;
+        }
+    }
+
+    pass_test(result);
+}
+
+// Matches a span cut out of a larger buffer with every engine and every tier of the matcher, none of which may
+// look at the bytes after the span
+void test_span(const SpanCase& test, TestResult& result) {
+    begin_test(test.description, result);
+    std::cout << "  │ Regex: \"" << test.regex << "\"  Span: " << test.length << " of " << test.buffer.size()
+              << " bytes\n";
+    std::cout << "  │ Expect: " << (test.should_match ? "MATCH" : "NO MATCH") << "\n";
+
+    const std::shared_ptr<const Expression> expression = parse_test_regex(test.regex, test.description, result, false);
+    const std::shared_ptr<const Expression> optimized_expression =
+        expression ? parse_test_regex(test.regex, test.description, result) : nullptr;
+    if (!optimized_expression) {
+        return;
+    }
+
+    const PikeProgram program = expression->generatePikeProgram();
+    const PikeProgram optimized = optimized_expression->generatePikeProgram();
+    const auto dfa = std::make_shared<LazyDfa>(optimized);
+    const DfaTable table(optimized);
+    const std::optional<std::vector<ShapePiece>> shape = expression->shape();
+    const std::shared_ptr<const FastPath> fast_path = shape ? FastPath::classify(*shape) : nullptr;
+
+    std::optional<Matcher> compiled;
+    try {
+        MimirCodeGen code_gen;
+        compiled.emplace(code_gen.make_matcher(optimized_expression->generateMatcherSource(code_gen)));
+    }
+    catch (const std::exception& e) {
+        std::cout << "  │ Error: " << e.what() << "\n";
+        fail_test("COMPILE ERROR", test.description + ": \"" + test.regex + "\" (compile error)", result);
+        return;
+    }
+
+    // the matcher of a tiered run, before and after the compiled code takes over
+    const Matcher tiered(dfa);
+    const Matcher promoted(dfa);
+    promoted.promote(*compiled);
+
+    using Engine = std::function<bool(const char*, size_t)>;
+    std::vector<std::pair<std::string, Engine>> engines = {
+        {"Pike VM", [&](const char* begin, size_t length) { return program.matches(begin, length); }},
+        {"optimized Pike VM", [&](const char* begin, size_t length) { return optimized.matches(begin, length); }},
+        {"lazy DFA", [&](const char* begin, size_t length) { return dfa->matches(begin, length); }},
+        {"DFA table", [&](const char* begin, size_t length) { return table.matches(begin, length); }},
+        {"compiled", [&](const char* begin, size_t length) { return (*compiled)(begin, length); }},
+        {"tiered", [&](const char* begin, size_t length) { return tiered(begin, length); }},
+        {"promoted", [&](const char* begin, size_t length) { return promoted(begin, length); }},
+        {"batch", [&](const char* begin, size_t length) {
+            const MatchSpan span{begin, length};
+            uint64_t results = 0;
+            tiered.match_batch(&span, 1, &results);
+            return results != 0;
+        }},
+    };
+    if (fast_path) {
+        engines.emplace_back("fast path", [&](const char* begin, size_t length) {
+            return fast_path->matches(begin, length);
+        });
+    }
+
+    for (const auto& [name, matches] : engines) {
+        if (matches(test.buffer.data(), test.length) != test.should_match) {
+            fail_test(std::string(test.should_match ? "NO MATCH" : "MATCH") + " (" + name + ")",
+                      test.description + ": \"" + test.regex + "\" (" + name + ")", result);
+            return;
+        }
+    }
+
+    pass_test(result);
+}
+
+// Compiles the patterns with the services, destroys the services and then the matchers one by one, and checks every
+// time that each remaining matcher matches the line of its own pattern and no other
+void test_compile(const CompileCase& test, TestResult& result) {
+    begin_test(test.description, result);
+    std::cout << "  │ Patterns: " << test.count << "  Services: " << test.services << " of " << test.workers
+              << " workers  Backend: " << (test.backend == MimirCodeGen::Backend::Jit ? "JIT" : "clang") << "\n";
+    std::cout << "  │ Expect: EVERY MATCHER MATCHES ITS OWN LINE ONLY\n";
+
+    std::vector<std::string> patterns;
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < test.count; i++) {
+        patterns.push_back("p" + std::to_string(i) + "x[a-z]*");
+        lines.push_back("p" + std::to_string(i) + "xabc");
+    }
+
+    std::vector<std::vector<std::optional<Matcher>>> compiled(test.services);
+    std::vector<std::string> errors(test.services);
+    {
+        std::vector<std::unique_ptr<CompileService>> services;
+        for (size_t service = 0; service < test.services; service++) {
+            services.push_back(std::make_unique<CompileService>(
+                test.workers, [&test](MimirCodeGen& code_gen) { code_gen.set_backend(test.backend); }));
+        }
+
+        std::vector<std::thread> threads;
+        for (size_t service = 0; service < test.services; service++) {
+            threads.emplace_back([&, service] {
+                try {
+                    for (Matcher& matcher : services[service]->compile(patterns)) {
+                        compiled[service].emplace_back(std::move(matcher));
+                    }
+                }
+                catch (const std::exception& e) {
+                    errors[service] = e.what();
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    for (const std::string& error : errors) {
+        if (!error.empty()) {
+            std::cout << "  │ Error: " << error << "\n";
+            fail_test("COMPILE ERROR", test.description + " (compile error)", result);
+            return;
+        }
+    }
+
+    const auto check = [&](const std::vector<std::optional<Matcher>>& matchers) -> std::string {
+        for (size_t i = 0; i < matchers.size(); i++) {
+            for (size_t j = 0; matchers[i] && j < lines.size(); j++) {
+                const Matcher& matcher = *matchers[i];
+                if (matcher(lines[j].data(), lines[j].size()) != (i == j) || matcher(lines[j].c_str()) != (i == j)) {
+                    return "\"" + patterns[i] + "\" on \"" + lines[j] + "\"";
+                }
+            }
+        }
+        return "";
+    };
+
+    // every other matcher first, so that the matchers of a module go away while others of it are still in use
+    for (std::vector<std::optional<Matcher>>& matchers : compiled) {
+        std::string problem = check(matchers);
+        const size_t half = (matchers.size() + 1) / 2;
+        for (size_t step = 0; step < matchers.size() && problem.empty(); step++) {
+            matchers[step < half ? 2 * step : 2 * (step - half) + 1].reset();
+            problem = check(matchers);
+        }
+        if (!problem.empty()) {
+            fail_test("WRONG RESULT OF " + problem, test.description + ": " + problem, result);
+            return;
+        }
+    }
+
+    pass_test(result);
+}
+
+// Matches a batch of lines with the lazy DFA, which walks them in lockstep, and checks every result against the
+// Pike VM
+void test_batch(const BatchCase& test, TestResult& result) {
+    begin_test(test.description, result);
+    std::cout << "  │ Regex: \"" << test.regex << "\"  Lines: " << test.count << " over \"" << test.alphabet
+              << "\"  Cache: " << test.cache_bytes << " bytes\n";
+    std::cout << "  │ Expect: SAME RESULTS\n";
+
+    const std::shared_ptr<const Expression> expression = parse_test_regex(test.regex, test.description, result);
+    if (!expression) {
+        return;
+    }
+
+    // the same lines on every run
+    uint64_t random = 0x9e3779b97f4a7c15;
+    const auto next_random = [&random] {
+        random = random * 6364136223846793005 + 1442695040888963407;
+        return random >> 33;
+    };
+
+    std::vector<std::string> lines(test.count);
+    for (std::string& line : lines) {
+        line.resize(next_random() % (test.max_length + 1));
+        for (char& c : line) {
+            c = test.alphabet[next_random() % test.alphabet.size()];
+        }
+    }
+
+    std::vector<MatchSpan> spans;
+    for (const std::string& line : lines) {
+        spans.push_back(MatchSpan{line.data(), line.size()});
+    }
+
+    const PikeProgram program = expression->generatePikeProgram();
+    const LazyDfa dfa(program, test.cache_bytes);
+    std::vector<uint64_t> results((spans.size() + 63) / 64, 0);
+    dfa.match_batch(spans.data(), spans.size(), results.data());
+
+    for (size_t i = 0; i < lines.size(); i++) {
+        const bool matched = (results[i / 64] >> (i % 64) & 1) != 0;
+        if (matched != program.matches(spans[i].begin, spans[i].length)) {
+            fail_test(std::string(matched ? "MATCH" : "NO MATCH") + " (line " + std::to_string(i) + ")",
+                      test.description + ": \"" + test.regex + "\" on \"" + lines[i] + "\"", result);
+            return;
+        }
+    }
+
+    pass_test(result);
+}
+
+// Checks the literals the prefilter searches for, one of which every matching line contains
+void test_literals(const LiteralCase& test, TestResult& result) {
+    const auto show = [](const std::vector<std::string>& literals) {
+        std::string shown;
+        for (const auto& literal : literals) {
+            shown += " \"" + literal + "\"";
+        }
+        return shown;
+    };
+
+    begin_test(test.description, result);
+    std::cout << "  │ Regex: \"" << test.regex << "\"\n";
+    std::cout << "  │ Expect:" << show(test.literals) << "\n";
+
+    const std::shared_ptr<const Expression> expression = parse_test_regex(test.regex, test.description, result);
+    if (!expression) {
+        return;
+    }
+
+    if (const std::vector<std::string> literals = expression->extractLiterals().required_literals();
+        literals != test.literals) {
+        fail_test(show(literals), test.description + ": \"" + test.regex + "\" (wrong literals)", result);
+        return;
+    }
+
+    pass_test(result);
+}
+
+// Checks the bounds of the line length, outside of which the prefilter rejects lines
+void test_length(const LengthCase& test, TestResult& result) {
+    const auto show = [](const size_t length) {
+        return length == LengthBounds::unbounded ? std::string("∞") : std::to_string(length);
+    };
+
+    begin_test(test.description, result);
+    std::cout << "  │ Regex: \"" << test.regex << "\"\n";
+    std::cout << "  │ Expect: " << show(test.min) << ".." << show(test.max) << "\n";
+
+    const std::shared_ptr<const Expression> expression = parse_test_regex(test.regex, test.description, result);
+    if (!expression) {
+        return;
+    }
+
+    if (const LengthBounds bounds = expression->lengthBounds(); bounds.min != test.min || bounds.max != test.max) {
+        fail_test(show(bounds.min) + ".." + show(bounds.max),
+                  test.description + ": \"" + test.regex + "\" (wrong bounds)", result);
+        return;
+    }
+
+    pass_test(result);
+}
+
+// Checks whether the prefilter lets the input through to the matcher
+void test_prefilter(const MatchCase& test, TestResult& result) {
+    begin_test(test.description, result);
+    std::cout << "  │ Regex: \"" << test.regex << "\"  Input: \"" << test.input << "\"\n";
+    std::cout << "  │ Expect: " << (test.should_match ? "PASSED ON" : "REJECTED") << "\n";
+
+    const std::shared_ptr<const Expression> expression = parse_test_regex(test.regex, test.description, result);
+    if (!expression) {
+        return;
+    }
+
+    const std::shared_ptr<const Prefilter> prefilter = Prefilter::make(
+        expression->lengthBounds(), expression->edgeBytes(), expression->extractLiterals().required_literals());
+
+    if (const bool passed = prefilter == nullptr || prefilter->may_match(test.input.data(), test.input.size());
+        passed != test.should_match) {
+        fail_test(passed ? "PASSED ON" : "REJECTED",
+                  test.description + ": \"" + test.regex + "\" on \"" + test.input + "\"", result);
+        return;
+    }
+
+    pass_test(result);
+}
+
+// Checks that the optimizer rewrites the regex into the same AST as the parser builds for the optimized one
+void test_optimize(const OptimizeCase& test, TestResult& result) {
+    begin_test(test.description, result);
+    std::cout << "  │ Regex: \"" << test.regex << "\"\n";
+    std::cout << "  │ Expect: \"" << test.optimized << "\"\n";
+
+    const std::shared_ptr<const Expression> expression = parse_test_regex(test.regex, test.description, result);
+    const std::shared_ptr<const Expression> expected =
+        expression ? parse_test_regex(test.optimized, test.description, result, false) : nullptr;
+    if (!expected) {
+        return;
+    }
+
+    std::string key;
+    std::string expected_key;
+    expression->appendKey(key);
+    expected->appendKey(expected_key);
+
+    if (key != expected_key) {
+        fail_test("DIFFERENT AST", test.description + ": \"" + test.regex + "\" (not \"" + test.optimized + "\")",
+                  result);
+        return;
+    }
+
+    pass_test(result);
+}
+
+// Matches the original and the optimized regex on the Pike VM against all inputs of the case, shortest first
+void test_equivalence(const EquivalenceCase& test, TestResult& result) {
+    begin_test(test.description, result);
+    std::cout << "  │ Regex: \"" << test.regex << "\"  Inputs: \"" << test.alphabet << "\" up to " << test.max_length
+              << " bytes\n";
+    std::cout << "  │ Expect: SAME MATCHES\n";
+
+    const std::shared_ptr<const Expression> expression = parse_test_regex(test.regex, test.description, result, false);
+    const std::shared_ptr<const Expression> optimized =
+        expression ? parse_test_regex(test.regex, test.description, result) : nullptr;
+    if (!optimized) {
+        return;
+    }
+
+    const PikeProgram original_program = expression->generatePikeProgram();
+    const PikeProgram optimized_program = optimized->generatePikeProgram();
+
+    size_t inputs = 0;
+    std::string input;
+    std::vector<size_t> digits;
+
+    while (true) {
+        input.clear();
+        for (const size_t digit : digits) {
+            input += test.alphabet[digit];
+        }
+
+        inputs++;
+        if (const bool matches = original_program.matches(input.data(), input.size());
+            optimized_program.matches(input.data(), input.size()) != matches) {
+            fail_test(std::string(matches ? "NO MATCH" : "MATCH") + " ON \"" + input + "\"",
+                      test.description + ": \"" + test.regex + "\" on \"" + input + "\"", result);
+            return;
+        }
+
+        // the next input counts up in the alphabet, with one more byte once all of this length are done
+        size_t position = 0;
+        while (position < digits.size() && ++digits[position] == test.alphabet.size()) {
+            digits[position++] = 0;
+        }
+        if (position == digits.size()) {
+            if (digits.size() == test.max_length) {
+                break;
+            }
+            digits.push_back(0);
+        }
+    }
+
+    std::cout << "  │ Result: ✅ " << inputs << " inputs\n";
+    pass_test(result);
+}
+
+// Compresses the input in the given format, which must be supported by the build
+std::string compress([[maybe_unused]] const Compression compression, [[maybe_unused]] const std::string& input) {
+#ifdef REGEXFE_HAVE_ZLIB
+    if (compression == Compression::Gzip) {
+        z_stream z{};
+        // 16: write a gzip header rather than a zlib one
+        deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+        std::string output(deflateBound(&z, input.size()), '\0');
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        z.avail_in = static_cast<uInt>(input.size());
+        z.next_out = reinterpret_cast<Bytef*>(output.data());
+        z.avail_out = static_cast<uInt>(output.size());
+        deflate(&z, Z_FINISH);
+        output.resize(z.total_out);
+        deflateEnd(&z);
+        return output;
+    }
+#endif
+#ifdef REGEXFE_HAVE_ZSTD
+    if (compression == Compression::Zstd) {
+        std::string output(ZSTD_compressBound(input.size()), '\0');
+        output.resize(ZSTD_compress(output.data(), output.size(), input.data(), input.size(), 1));
+        return output;
+    }
+#endif
+    throw std::runtime_error("compression not supported by this build");
+}
+
+// The piece count times in a row
+std::string repeat(const std::string& piece, const size_t count) {
+    std::string repeated;
+    for (size_t i = 0; i < count; i++) {
+        repeated += piece;
+    }
+    return repeated;
+}
+
+// Numbered lines of some text, count of them
+std::string sample_lines(const size_t count) {
+    std::string lines;
+    for (size_t i = 0; i < count; i++) {
+        lines += std::to_string(i) + ": GET /index.html HTTP/1.1 " + std::to_string(i * 7919 % 1000) + "\n";
+    }
+    return lines;
+}
+
+// Compresses every member on its own, and checks that the decompressor gives back all of them, in order
+void test_decompress(const DecompressCase& test, TestResult& result) {
+    std::string input;
+    std::string compressed;
+    for (const auto& member : test.members) {
+        input += member;
+        compressed += compress(test.compression, member);
+    }
+
+    begin_test(test.description, result);
+    std::cout << "  │ Input: " << input.size() << " bytes in " << test.members.size() << " members, "
+              << compressed.size() << " compressed\n";
+    std::cout << "  │ Expect: SAME BYTES\n";
+
+    if (detect_compression(compressed) != test.compression) {
+        fail_test("WRONG FORMAT DETECTED", test.description + " (wrong format detected)", result);
+        return;
+    }
+
+    std::string output;
+    try {
+        BlockStream stream;
+        stream.start([&](BlockStream& blocks) { decompress(test.compression, compressed, blocks); });
+        stream.for_each_block([&](const char* data, const size_t size) { output.append(data, size); });
+    }
+    catch (const InputError& e) {
+        std::cout << "  │ Error: " << e.what() << "\n";
+        fail_test("DECOMPRESSION ERROR", test.description + " (decompression error)", result);
+        return;
+    }
+
+    if (output != input) {
+        fail_test("DIFFERENT BYTES (" + std::to_string(output.size()) + " bytes)",
+                  test.description + " (different bytes)", result);
+        return;
+    }
+
+    pass_test(result);
+}
+
+// Encodes the results of the lines of a file into frames, and checks that the reader gives back the same results
+void test_frames(const FrameCase& test, TestResult& result) {
+    constexpr uint32_t file_index = 7;
+    // lines appended at once, not a multiple of the 64 lines of a bitmap word
+    constexpr size_t chunk_lines = 1000;
+
+    const auto selected = [&](const uint64_t line) { return line % test.every == 0; };
+
+    begin_test(test.description, result);
+    std::cout << "  │ Lines: " << test.line_count << ", selected: line % " << test.every << " == 0, added "
+              << (test.bulk ? "in chunks" : "one at a time") << "\n";
+    std::cout << "  │ Expect: SAME RESULTS\n";
+
+    StringOutput output;
+    FrameEncoder encoder(test.kind, file_index);
+
+    if (test.bulk) {
+        for (size_t begin = 0; begin < test.line_count; begin += chunk_lines) {
+            const size_t count = std::min(chunk_lines, test.line_count - begin);
+            std::vector<uint64_t> bits((count + 63) / 64);
+            for (size_t i = 0; i < count; i++) {
+                bits[i / 64] |= uint64_t{selected(begin + i)} << (i % 64);
+            }
+            encoder.append(output, bits, count);
+        }
+    }
+    else {
+        for (size_t line = 0; line < test.line_count; line++) {
+            encoder.add(output, selected(line));
+        }
+    }
+    encoder.finish(output);
+
+    std::vector<bool> decoded(test.line_count, false);
+    std::string problem;
+
+    try {
+        const ResultReader reader(output.view().data(), output.size());
+
+        // the frames cover all lines of the file, one after another, and only the last one is flagged as such
+        uint64_t covered = 0;
+        for (size_t i = 0; i < reader.frame_count() && problem.empty(); i++) {
+            const ResultFrameHeader header = reader.frame(i).header();
+            if (header.kind != test.kind || header.file_index != file_index || header.first_line != covered ||
+                header.last != (i + 1 == reader.frame_count())) {
+                problem = "WRONG HEADER IN FRAME " + std::to_string(i);
+            }
+            covered += header.line_count;
+        }
+        if (problem.empty() && (reader.frame_count() == 0 || covered != test.line_count)) {
+            problem = "WRONG LINES COVERED";
+        }
+
+        reader.for_each_result([&](uint32_t, const uint64_t line, const bool is_selected) {
+            if (line < test.line_count) {
+                decoded[line] = is_selected;
+            }
+            else if (problem.empty()) {
+                problem = "LINE " + std::to_string(line) + " OUT OF RANGE";
+            }
+        });
+    }
+    catch (const std::runtime_error& e) {
+        problem = std::string("INVALID OUTPUT: ") + e.what();
+    }
+
+    for (uint64_t line = 0; line < test.line_count && problem.empty(); line++) {
+        if (decoded[line] != selected(line)) {
+            problem = "WRONG RESULT OF LINE " + std::to_string(line);
+        }
+    }
+
+    if (!problem.empty()) {
+        fail_test(problem, test.description + " (" + problem + ")", result);
+        return;
+    }
+
+    pass_test(result);
+}
+
+// An anonymous temporary file, which output is written to through its descriptor and then read back
+class TemporaryFile {
+
+    std::FILE* const file;
+
+public:
+    TemporaryFile() : file(std::tmpfile()) {
+        if (file == nullptr) {
+            throw std::runtime_error("failed to create a temporary file");
+        }
+    }
+
+    TemporaryFile(const TemporaryFile&) = delete;
+    TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+    ~TemporaryFile() {
+        std::fclose(file);
+    }
+
+    [[nodiscard]] int fd() const {
+        return fileno(file);
+    }
+
+    // The number of bytes written so far
+    [[nodiscard]] size_t size() const {
+        std::fseek(file, 0, SEEK_END);
+        return static_cast<size_t>(std::ftell(file));
+    }
+
+    // Everything written so far, which leaves the file at its end, where the next writes go
+    [[nodiscard]] std::string contents() const {
+        std::string contents;
+        std::rewind(file);
+        char buffer[4096];
+        size_t read;
+        while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            contents.append(buffer, read);
+        }
+        return contents;
+    }
+
+};
+
+// Writes the lines through an OutputWriter, and checks that the file receives them in large batches, or every line
+// right away when line buffered, and all of them once flushed and once the writer is destroyed
+void test_output(const OutputCase& test, TestResult& result) {
+    // the smallest batch a buffered writer hands to the file
+    constexpr size_t min_batch = 1 << 16;
+
+    begin_test(test.description, result);
+    std::cout << "  │ Lines: " << test.count << " of " << test.line_length << " bytes, "
+              << (test.line_buffered ? "line buffered" : "buffered") << "\n";
+    std::cout << "  │ Expect: " << (test.line_buffered ? "EVERY LINE AT ONCE" : "LARGE BATCHES") << "\n";
+
+    const TemporaryFile file;
+    std::string expected;
+    std::string problem;
+
+    {
+        OutputWriter output(file.fd(), test.line_buffered);
+        size_t written = 0;
+
+        for (size_t i = 0; i < test.count && problem.empty(); i++) {
+            std::string line = std::to_string(i);
+            line.resize(test.line_length, static_cast<char>('a' + i % 26));
+            expected += line + "\n";
+
+            // all but the last byte at once, and the last one on its own
+            output.write(std::string_view(line).substr(0, line.size() - 1));
+            output.put(line.back());
+            output.end_line();
+
+            if (const size_t size = file.size(); test.line_buffered && size != expected.size()) {
+                problem = "LINE " + std::to_string(i) + " NOT WRITTEN AT ONCE";
+            }
+            else if (!test.line_buffered && size != written && size - written < min_batch) {
+                problem = "BATCH OF " + std::to_string(size - written) + " BYTES";
+            }
+            else {
+                written = size;
+            }
+        }
+
+        if (problem.empty()) {
+            output.flush();
+            if (file.contents() != expected) {
+                problem = "WRONG OUTPUT WHEN FLUSHED";
+            }
+        }
+
+        output.write("last");
+        output.end_line();
+        expected += "last\n";
+    }
+
+    if (problem.empty() && file.contents() != expected) {
+        problem = "WRONG OUTPUT WHEN DESTROYED";
+    }
+
+    if (!problem.empty()) {
+        fail_test(problem, test.description + " (" + problem + ")", result);
+        return;
+    }
+
+    pass_test(result);
+}
+
+// A directory of its own among the temporary files, removed with everything in it when done
+class TemporaryDirectory {
+
+    std::filesystem::path path;
+
+public:
+    TemporaryDirectory() {
+        std::random_device random;
+        do {
+            path = std::filesystem::temp_directory_path() / ("regexfe-test-" + std::to_string(random()));
+        } while (!std::filesystem::create_directory(path));
+    }
+
+    TemporaryDirectory(const TemporaryDirectory&) = delete;
+    TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+    ~TemporaryDirectory() {
+        std::error_code error;
+        std::filesystem::remove_all(path, error);
+    }
+
+    // The path of the file or directory of the given name, relative to this directory
+    [[nodiscard]] std::string path_of(const std::string& name) const {
+        return (path / name).string();
+    }
+
+    // Writes the file of the given name, creating the directories it is in, and returns its path
+    std::string write_file(const std::string& name, const std::string& contents) const {
+        const std::filesystem::path file = path / name;
+        std::filesystem::create_directories(file.parent_path());
+        std::ofstream(file, std::ios::binary) << contents;
+        return file.string();
+    }
+
 };
 
-// Always show MimIR for successful parses
-void test_regex(const std::string& regex, bool should_fail, const std::string& description, TestResult& result) {
-    std::cout << "\n  ┌─ Test: " << description << "\n";
-    std::cout << "  │ Regex: \"" << regex << "\"\n";
-    std::cout << "  │ Expect: " << (should_fail ? "FAIL" : "PASS") << "\n";
+// Writes the files, lists them with expand_paths and scans them for the lines of selected numbers, and checks that
+// every file is listed in order and reports all of its selected lines, in order
+void test_tree(const TreeCase& test, TestResult& result) {
+    const std::string regex = "\\d*7: .*";
 
-    result.total++;
+    begin_test(test.description, result);
+    std::cout << "  │ Files: " << test.file_lines.size() << "  Threads: "
+              << (test.threads == 0 ? "calling thread" : std::to_string(test.threads)) << "\n";
+    std::cout << "  │ Expect: EVERY FILE IN ORDER\n";
 
-    Expression* expression;
+    const std::shared_ptr<const Expression> expression = parse_test_regex(regex, test.description, result);
+    if (!expression) {
+        return;
+    }
+    const PikeProgram program = expression->generatePikeProgram();
 
-    try {
-        expression = parse_regex(regex);
+    // every file in one of three directories, every other one a level deeper
+    const TemporaryDirectory directory;
+    std::vector<std::string> expected_files;
+    std::map<std::string, std::vector<std::string>> expected_lines;
+    for (size_t i = 0; i < test.file_lines.size(); i++) {
+        const bool loose = i + 1 == test.file_lines.size();
+        const std::string name = loose ? "loose.log" : "tree/d" + std::to_string(i % 3) + (i % 2 ? "/nested" : "") +
+                                                           "/f" + std::to_string(i) + ".log";
+        const std::string lines = sample_lines(test.file_lines[i]);
+        const std::string file = directory.write_file(name, lines);
+        expected_files.push_back(file);
+
+        for (size_t begin = 0; begin < lines.size();) {
+            const size_t end = lines.find('\n', begin);
+            if (program.matches(lines.data() + begin, end - begin)) {
+                expected_lines[file].push_back(lines.substr(begin, end - begin));
+            }
+            begin = end + 1;
+        }
     }
-    catch (const LexerError& e) {
-        if (should_fail) {
-            std::cout << "  │ Result: ✅ EXPECTED ERROR\n";
-            std::cout << "  │ Error: " << e << "\n";
-            std::cout << "  └─ Status: PASS\n";
-            result.passed++;
+    // the files of the tree sorted by name, followed by the file named on its own
+    std::sort(expected_files.begin(), expected_files.end() - 1);
+
+    const std::vector<std::string> files = expand_paths({directory.path_of("tree"), expected_files.back()});
+    if (files != expected_files) {
+        fail_test("WRONG FILES", test.description + " (wrong files)", result);
+        return;
+    }
+
+    const Matcher matcher(std::make_shared<LazyDfa>(program));
+    const TemporaryFile output_file;
+    bool had_errors;
+    {
+        OutputWriter output(output_file.fd());
+        ScanOptions options;
+        options.print_file_names = true;
+        options.selection = Selection::Matching;
+        Scanner scanner(matcher, output, options);
+
+        if (test.threads == 0) {
+            for (const std::string& file : files) {
+                scanner.scan(file);
+            }
         }
         else {
-            std::cout << "  │ Result: ❌ UNEXPECTED ERROR\n";
-            std::cout << "  │ Error: " << e << "\n";
-            std::cout << "  └─ Status: FAIL\n";
-            result.failures.push_back(description + ": \"" + regex + "\" (unexpected error)");
+            ThreadPool pool(test.threads);
+            for (const std::string& file : files) {
+                scanner.scan(file, pool);
+            }
+            pool.wait_idle();
         }
+        had_errors = scanner.had_errors();
+    }
+
+    // lines of different files may interleave, but those of every file are in order
+    std::map<std::string, std::vector<std::string>> lines;
+    const std::string output = output_file.contents();
+    const size_t directory_length = directory.path_of("").size();
+    for (size_t begin = 0; begin < output.size();) {
+        const size_t end = output.find('\n', begin);
+        const size_t colon = output.find(':', begin + directory_length);
+        lines[output.substr(begin, colon - begin)].push_back(output.substr(colon + 1, end - colon - 1));
+        begin = end + 1;
+    }
+
+    if (had_errors || lines != expected_lines) {
+        const std::string problem = had_errors ? "INPUT ERROR" : "WRONG LINES";
+        fail_test(problem, test.description + " (" + problem + ")", result);
         return;
     }
-    catch (const ParserError& e) {
-        if (should_fail) {
-            std::cout << "  │ Result: ✅ EXPECTED ERROR\n";
-            std::cout << "  │ Error: " << e << "\n";
-            std::cout << "  └─ Status: PASS\n";
-            result.passed++;
+
+    pass_test(result);
+}
+
+// Feeds the input in pieces, each copied into the same buffer that is overwritten once it is fed, as streams are read,
+// and checks that every line is handed out once, in order, until the consumer asks to stop
+void test_assembly(const AssemblyCase& test, TestResult& result) {
+    begin_test(test.description, result);
+    std::cout << "  │ Input: " << test.input.size() << " bytes in pieces of";
+    for (const size_t size : test.piece_sizes) {
+        std::cout << " " << size;
+    }
+    std::cout << " bytes\n";
+
+    std::vector<std::string> expected;
+    for (size_t begin = 0; begin < test.input.size();) {
+        const size_t end = std::min(test.input.find('\n', begin), test.input.size());
+        expected.push_back(test.input.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    const bool stops = expected.size() > test.stop_after;
+    expected.resize(std::min(expected.size(), test.stop_after));
+    std::cout << "  │ Expect: " << expected.size() << " LINES" << (stops ? ", THEN STOP" : "") << "\n";
+
+    std::vector<std::string> lines;
+    const auto consumer = [&](const char* line, const size_t length) {
+        lines.emplace_back(line, length);
+        return lines.size() < test.stop_after;
+    };
+
+    LineAssembler assembler;
+    std::string buffer;
+    bool more = true;
+    for (size_t begin = 0, piece = 0; begin < test.input.size() && more; piece++) {
+        buffer.assign(test.input, begin, test.piece_sizes[piece % test.piece_sizes.size()]);
+        more = assembler.feed(buffer.data(), buffer.size(), consumer);
+        std::fill(buffer.begin(), buffer.end(), '#');
+        begin += buffer.size();
+    }
+    if (more) {
+        assembler.finish(consumer);
+    }
+
+    if (lines != expected || more == stops) {
+        const std::string problem = lines != expected ? "WRONG LINES" : stops ? "DID NOT STOP" : "STOPPED";
+        fail_test(problem, test.description + " (" + problem + ")", result);
+        return;
+    }
+
+    pass_test(result);
+}
+
+// Scans the input on the calling thread and on a pool, and checks the output and whether a line is found both times
+void test_scan_mode(const ScanModeCase& test, TestResult& result) {
+    begin_test(test.description, result);
+    std::cout << "  │ Regex: \"" << test.regex << "\"  Input: " << test.input.size() << " bytes\n";
+    std::cout << "  │ Expect: " << test.output.size() << " bytes of output, " << (test.found ? "FOUND" : "NOT FOUND")
+              << "\n";
+
+    const std::shared_ptr<const Expression> expression = parse_test_regex(test.regex, test.description, result);
+    if (!expression) {
+        return;
+    }
+
+    const Matcher matcher(std::make_shared<LazyDfa>(expression->generatePikeProgram()));
+    const TemporaryDirectory directory;
+    const std::string file = directory.write_file("input.log", test.input);
+
+    for (const size_t threads : {0, 3}) {
+        const TemporaryFile output_file;
+        bool found;
+        bool had_errors;
+        {
+            OutputWriter output(output_file.fd());
+            Scanner scanner(matcher, output, test.options);
+            if (threads == 0) {
+                scanner.scan(file);
+            }
+            else {
+                ThreadPool pool(threads);
+                scanner.scan(file, pool);
+                pool.wait_idle();
+            }
+            found = scanner.found_any();
+            had_errors = scanner.had_errors();
         }
-        else {
-            std::cout << "  │ Result: ❌ UNEXPECTED ERROR\n";
-            std::cout << "  │ Error: " << e << "\n";
-            std::cout << "  └─ Status: FAIL\n";
-            result.failures.push_back(description + ": \"" + regex + "\" (unexpected error)");
+
+        const std::string where = threads == 0 ? "calling thread" : "pool";
+        const std::string output = output_file.contents();
+        std::string problem;
+        if (had_errors) {
+            problem = "INPUT ERROR";
+        }
+        else if (output != test.output) {
+            problem = "WRONG OUTPUT";
         }
+        else if (found != test.found) {
+            problem = found ? "FOUND" : "NOT FOUND";
+        }
+
+        if (!problem.empty()) {
+            fail_test(problem + " (" + where + ")", test.description + " (" + problem + " on the " + where + ")",
+                      result);
+            return;
+        }
+    }
+
+    pass_test(result);
+}
+
+// Compiles the regex with the JIT and with clang, and checks both matchers, in span and C-string form, against the
+// Pike VM
+void test_backends(const BackendCase& test, TestResult& result) {
+    begin_test(test.description, result);
+    std::cout << "  │ Regex: \"" << test.regex << "\"  Inputs: " << test.inputs.size() << "\n";
+    std::cout << "  │ Expect: SAME RESULTS ON JIT AND CLANG\n";
+
+    const std::shared_ptr<const Expression> expression = parse_test_regex(test.regex, test.description, result);
+    if (!expression) {
         return;
     }
-    catch (...) {
-        std::cout << "  │ Result: ❌ UNKNOWN EXCEPTION\n";
-        std::cout << "  └─ Status: FAIL\n";
-        result.failures.push_back(description + ": \"" + regex + "\" (unknown exception)");
+    const PikeProgram program = expression->generatePikeProgram();
+
+    using Backend = MimirCodeGen::Backend;
+    for (const auto& [name, backend] : {std::pair{"JIT", Backend::Jit}, std::pair{"clang", Backend::Clang}}) {
+        std::optional<Matcher> matcher;
+        try {
+            MimirCodeGen code_gen;
+            code_gen.set_backend(backend);
+            matcher.emplace(code_gen.make_matcher(expression->generateMatcherSource(code_gen)));
+        }
+        catch (const std::exception& e) {
+            std::cout << "  │ Error: " << e.what() << "\n";
+            fail_test(std::string("COMPILE ERROR (") + name + ")",
+                      test.description + ": \"" + test.regex + "\" (compile error, " + name + ")", result);
+            return;
+        }
+
+        for (const std::string& input : test.inputs) {
+            const bool expected = program.matches(input.data(), input.size());
+            if ((*matcher)(input.data(), input.size()) != expected || (*matcher)(input.c_str()) != expected) {
+                fail_test(std::string(expected ? "NO MATCH" : "MATCH") + " (" + name + ")",
+                          test.description + ": \"" + test.regex + "\" on \"" + input + "\" (" + name + ")", result);
+                return;
+            }
+        }
+    }
+
+    pass_test(result);
+}
+
+// Validates the options on their own and when set on a MimirCodeGen, and compiles a regex with them with clang
+void test_codegen_options(const CodeGenCase& test, TestResult& result) {
+    const std::string regex = "a[bc]*d";
+
+    CodeGenOptions options;
+    options.opt_level = test.opt_level;
+    options.march = test.march;
+    options.mtune = test.mtune;
+    options.bitcode = test.bitcode;
+
+    begin_test(test.description, result);
+    std::cout << "  │ Flags: \"" << test.flags << "\"" << (test.bitcode ? " and bitcode" : "") << "\n";
+    std::cout << "  │ Expect: " << (!test.valid ? "REJECTED" : test.compiles ? "COMPILES" : "COMPILE ERROR") << "\n";
+
+    const auto accepts = [&test](const auto& set) {
+        try {
+            set();
+            return true;
+        }
+        catch (const std::runtime_error&) {
+            return false;
+        }
+    };
+
+    MimirCodeGen code_gen;
+    code_gen.set_backend(MimirCodeGen::Backend::Clang);
+
+    std::string problem;
+    if (accepts([&] { options.validate(); }) != test.valid) {
+        problem = test.valid ? "REJECTED" : "ACCEPTED";
+    }
+    else if (accepts([&] { code_gen.set_codegen_options(options); }) != test.valid) {
+        problem = test.valid ? "REJECTED BY MIMIR CODEGEN" : "ACCEPTED BY MIMIR CODEGEN";
+    }
+    else if (options.clang_flags() != test.flags) {
+        problem = "FLAGS \"" + options.clang_flags() + "\"";
+    }
+    if (!problem.empty()) {
+        fail_test(problem, test.description + " (" + problem + ")", result);
         return;
     }
 
-    if (should_fail) {
-        std::cout << "  │ Result: ❌ UNEXPECTED SUCCESS\n";
-        std::cout << "  └─ Status: FAIL\n";
-        result.failures.push_back(description + ": \"" + regex + "\" (should have failed)");
+    if (test.valid) {
+        const std::shared_ptr<const Expression> expression = parse_test_regex(regex, test.description, result);
+        if (!expression) {
+            return;
+        }
+
+        std::optional<Matcher> matcher;
+        try {
+            matcher.emplace(code_gen.make_matcher(expression->generateMatcherSource(code_gen)));
+        }
+        catch (const std::runtime_error& e) {
+            if (test.compiles) {
+                std::cout << "  │ Error: " << e.what() << "\n";
+            }
+        }
+
+        if (matcher.has_value() != test.compiles) {
+            problem = test.compiles ? "COMPILE ERROR" : "COMPILED";
+        }
+        else if (matcher && (!(*matcher)("abcbd") || (*matcher)("abx"))) {
+            problem = "WRONG RESULTS";
+        }
+        if (!problem.empty()) {
+            fail_test(problem, test.description + " (" + problem + ")", result);
+            return;
+        }
+    }
+
+    pass_test(result);
+}
+
+// Checks the set of bytes the parser makes of a literal, a class or a bracket expression, as a list of ranges
+void test_byte_set(const ByteSetCase& test, TestResult& result) {
+    const auto show = [](const std::vector<std::pair<unsigned char, unsigned char>>& ranges) {
+        const auto show_byte = [](const unsigned char c) {
+            if (c > ' ' && c < 127) {
+                return std::string(1, static_cast<char>(c));
+            }
+            constexpr char digits[] = "0123456789abcdef";
+            return std::string("\\x") + digits[c >> 4] + digits[c & 15];
+        };
+        std::string shown;
+        for (const auto& [lower, upper] : ranges) {
+            shown += " " + show_byte(lower) + (lower == upper ? "" : "-" + show_byte(upper));
+        }
+        return shown;
+    };
+
+    begin_test(test.description, result);
+    std::cout << "  │ Regex: \"" << test.regex << "\"\n";
+    std::cout << "  │ Expect:" << show(test.ranges) << "\n";
+
+    const std::shared_ptr<const Expression> expression = parse_test_regex(test.regex, test.description, result, false);
+    if (!expression) {
         return;
     }
 
-    MimirCodeGen code_gen;
-    MimRegex mim_result = expression->generateMimIR(code_gen);
+    const std::optional<std::vector<ShapePiece>> shape = expression->shape();
+    if (!shape || shape->size() != 1 || (*shape)[0].optional || (*shape)[0].repeated) {
+        fail_test("NOT A SINGLE SET", test.description + ": \"" + test.regex + "\" (not a single set)", result);
+        return;
+    }
 
-    // Show MimIR output
-    std::ostringstream oss;
-    oss << mim_result;
-    std::string mimir_str = oss.str();
+    std::vector<std::pair<unsigned char, unsigned char>> ranges;
+    (*shape)[0].bytes.for_each_range([&](const unsigned char lower, const unsigned char upper) {
+        ranges.emplace_back(lower, upper);
+    });
 
-    // Clean up newlines
-    std::erase(mimir_str, '\n');
+    if (ranges != test.ranges) {
+        fail_test(show(ranges), test.description + ": \"" + test.regex + "\" (wrong ranges)", result);
+        return;
+    }
 
-    std::cout << "  │ Result: ✅ SUCCESS\n";
-    std::cout << "  │ MimIR: " << mimir_str << "\n";
-    std::cout << "  └─ Status: PASS\n";
-    result.passed++;
+    pass_test(result);
+}
+
+// Parses the regex on another thread, then parses and drops other regexes, one of them invalid, on this thread, and
+// checks that the AST, whose arena it owns, is unchanged and still matches the input
+void test_arena(const ArenaCase& test, TestResult& result) {
+    begin_test(test.description, result);
+    std::cout << "  │ Regex: " << test.regex.size() << " bytes, " << (test.optimize ? "optimized" : "not optimized")
+              << "\n";
+    std::cout << "  │ Expect: " << (test.should_match ? "MATCH" : "NO MATCH") << " AFTER OTHER PARSES\n";
+
+    std::shared_ptr<const Expression> expression;
+    std::thread([&] {
+        try {
+            expression = parse_regex(test.regex, test.optimize);
+        }
+        catch (...) {
+            // reported below
+        }
+    }).join();
+    if (!expression) {
+        fail_test("PARSE ERROR", test.description + " (parse error)", result);
+        return;
+    }
+
+    std::string key;
+    expression->appendKey(key);
+
+    try {
+        static_cast<void>(parse_regex("(a|b"));
+    }
+    catch (...) {
+        // expected, the arena of the failed parse is gone
+    }
+    for (size_t i = 0; i < 1000; i++) {
+        static_cast<void>(parse_regex("x(y|z)*" + std::to_string(i), i % 2 == 0));
+    }
+
+    const std::shared_ptr<const Expression> reparsed =
+        parse_test_regex(test.regex, test.description, result, test.optimize);
+    if (!reparsed) {
+        return;
+    }
+
+    std::string reparsed_key;
+    std::string current_key;
+    reparsed->appendKey(reparsed_key);
+    expression->appendKey(current_key);
+
+    if (current_key != key || reparsed_key != key) {
+        fail_test("DIFFERENT AST", test.description + " (different AST)", result);
+        return;
+    }
 
+    if (expression->generatePikeProgram().matches(test.input.data(), test.input.size()) != test.should_match) {
+        fail_test(test.should_match ? "NO MATCH" : "MATCH", test.description + " (wrong result)", result);
+        return;
+    }
+
+    pass_test(result);
 }
 
-void run_test_section(const std::string& section_name, const std::vector<TestCase>& tests, TestResult& result) {
-    std::cout << "\n╔════════════════════════════════════════════════════════════════╗\n";
-    std::cout << "║ " << std::left << std::setw(62) << section_name << "║\n";
-    std::cout << "╚════════════════════════════════════════════════════════════════╝\n";
+// Lexes the regex as the beginning of a longer buffer, whose next byte would complete an escape at its end, and checks
+// the tokens and the error, if any
+void test_lex(const LexCase& test, TestResult& result) {
+    begin_test(test.description, result);
+    std::cout << "  │ Regex: \"" << test.regex << "\"\n";
+    std::cout << "  │ Expect: " << test.tokens.size() << " TOKENS"
+              << (test.error_position ? ", THEN ERROR AT " + std::to_string(*test.error_position) : "") << "\n";
 
-    for (const auto& test : tests) {
-        test_regex(test.regex, test.should_fail, test.description, result);
+    const std::string buffer = test.regex + "n";
+    Lexer lexer(std::string_view(buffer).substr(0, test.regex.size()));
+
+    std::vector<Token> tokens;
+    std::optional<size_t> error_position;
+    try {
+        for (Token token = lexer.lex(); token.id != T_EOF; token = lexer.lex()) {
+            tokens.push_back(token);
+        }
+        // the end stays the end
+        if (const Token token = lexer.lex(); token.id != T_EOF || token.position != test.regex.size()) {
+            fail_test("WRONG END", test.description + ": \"" + test.regex + "\" (wrong end)", result);
+            return;
+        }
+    }
+    catch (const LexerError& e) {
+        error_position = e.position;
+    }
+
+    std::string problem;
+    for (size_t i = 0; i < std::max(tokens.size(), test.tokens.size()) && problem.empty(); i++) {
+        if (i >= tokens.size() || i >= test.tokens.size() || tokens[i].id != test.tokens[i].id ||
+            tokens[i].position != test.tokens[i].position || tokens[i].character != test.tokens[i].character) {
+            problem = "WRONG TOKEN " + std::to_string(i);
+        }
+    }
+    if (problem.empty() && error_position != test.error_position) {
+        problem = error_position ? "ERROR AT " + std::to_string(*error_position) : "NO ERROR";
+    }
+
+    if (!problem.empty()) {
+        fail_test(problem, test.description + ": \"" + test.regex + "\" (" + problem + ")", result);
+        return;
     }
+
+    pass_test(result);
 }
 
 int run_tests() {
@@ -599,6 +2001,392 @@ int run_tests() {
         {"a(b|c)*d", false, "Spec example: 'a', (b OR c) zero or more times, then 'd'"},
     }, result);
 
+    // ════════════════════════════════════════════════════════════════
+    // TEST: matching with the Pike VM and the lazy DFA
+    // ════════════════════════════════════════════════════════════════
+    run_section("Interpreters - Whole-Line Matching", {
+        {"", "", true, "Empty regex matches empty input"},
+        {"", "a", false, "Empty regex rejects non-empty input"},
+        {"abc", "abc", true, "Literals match exactly"},
+        {"abc", "abcd", false, "Match must cover the whole input"},
+        {"a.c", "a-c", true, "Dot matches any character"},
+        {"a(b|c)*d", "abcbd", true, "Spec example matches"},
+        {"a(b|c)*d", "abxd", false, "Spec example rejects other characters"},
+        {"\\w+@\\w+", "me@host", true, "Word characters around a literal"},
+        {"\\d?\\d", "7", true, "Optional digit may be absent"},
+        {"[^a-z\\d]+", "A_!", true, "Negated set with range and class"},
+        {"[^a-z\\d]+", "A1", false, "Negated set rejects a digit"},
+        {"(?:a|)*[]-]+", "aa]-", true, "Star over an alternative matching empty"},
+        {"(a*)*b", "aaab", true, "Nested stars"},
+        {"(a*)*b", "aaa", false, "Nested stars still need the final literal"},
+        {"\\s\\S", "\t.", true, "Whitespace then non-whitespace"},
+    }, test_match, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: spans of larger buffers, matched by the compiled code too
+    // ════════════════════════════════════════════════════════════════
+    run_section("Compiled Spans - Length-Bounded Matching", {
+        {"a*", "aa", 1, true, "Byte after the span that the regex would consume"},
+        {"ab", "abc", 2, true, "Span is a prefix of the buffer"},
+        {"abc", "abc", 2, false, "Match would need the byte after the span"},
+        {"a\\d*", "a12x", 3, true, "Digits up to the end of the span"},
+        {"a.c", std::string("a\0cd", 4), 3, true, "Dot matches an embedded NUL"},
+        {"[^x]+", std::string("a\0b\0", 4), 3, true, "Negated set matches an embedded NUL"},
+        {"ab", std::string("a\0b", 3), 3, false, "Embedded NUL is not the end of the span"},
+        {"", "x", 0, true, "Empty span"},
+        // 2^14 DFA states, too many to compile, so the matcher runs on a lazy DFA
+        {"(a|b)*a" + repeat("(a|b)", 13), "ba" + repeat("b", 13) + "a", 15, true, "DFA too large to compile"},
+        {"(a|b)*a" + repeat("(a|b)", 13), "ba" + repeat("b", 13) + "a", 16, false,
+         "DFA too large to compile rejects"},
+    }, test_span, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: lines with NUL bytes, which every engine matches like any other byte
+    // ════════════════════════════════════════════════════════════════
+    run_section("NUL Bytes - Every Engine", {
+        {"a.c", std::string("a\0c", 3), 3, true, "Dot matches NUL"},
+        {"a[^b]c", std::string("a\0c", 3), 3, true, "Negated set matches NUL"},
+        {"[^x]*", std::string("\0\0", 2), 2, true, "Negated set with star"},
+        {"\\W", std::string("\0", 1), 1, true, "Non-word class matches NUL"},
+        {"\\w+", std::string("ab\0", 3), 3, false, "Word class rejects NUL"},
+        {"a\\s*", std::string("a\0", 2), 2, false, "Whitespace class rejects NUL"},
+        {"ERROR.*", std::string("ERROR\0x", 7), 7, true, "Prefix followed by NUL"},
+        {".*\\.log", std::string("\0.log", 5), 5, true, "Suffix after NUL"},
+        {".*ERROR.*", std::string("\0ERROR\0", 7), 7, true, "Literal between NUL bytes"},
+        {"abc", std::string("ab\0", 3), 3, false, "NUL in place of a literal"},
+    }, test_span, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: compiling many regexes into shared modules, on several services at once
+    // ════════════════════════════════════════════════════════════════
+    using Backend = MimirCodeGen::Backend;
+    std::vector<CompileCase> compile_cases = {
+        {12, 1, 1, Backend::Clang, "One module of all patterns"},
+        {12, 1, 3, Backend::Clang, "One module per worker"},
+        {12, 3, 2, Backend::Clang, "Concurrent services keep their temporary files apart"},
+    };
+    if (MimirCodeGen::has_jit()) {
+        compile_cases.insert(compile_cases.end(), {
+            {12, 1, 1, Backend::Jit, "One JIT module of all patterns"},
+            {12, 3, 2, Backend::Jit, "Concurrent services with the JIT"},
+        });
+    }
+    run_section("Compile Service - Batches of Regexes", compile_cases, test_compile, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: batches of lines in the lazy DFA, also with caches flushed in the middle of the batch
+    // ════════════════════════════════════════════════════════════════
+    constexpr size_t default_cache = LazyDfa::default_cache_bytes;
+    run_section("Lazy DFA - Batches", {
+        {"[ab]*a[ab][ab]", "abc", 200, 12, default_cache, "Lanes retire on dead spans and take up the next ones"},
+        {"\\d+-\\d+", "0123-", 130, 20, default_cache, "Empty lines and a batch that ends inside a word"},
+        {"[ab]*a[ab][ab][ab][ab]", "ab", 300, 40, 2048, "Small cache, flushed within the batch"},
+        {"(a|b)*a(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)", "ab", 100, 400, 1024, "Tiny cache, flushed over and over"},
+        {"[ab]*a[ab][ab][ab][ab]", "abc", 257, 60, 1024, "Tiny cache and dead spans"},
+    }, test_batch, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: regexes of trivial shapes, which the fast path matches too
+    // ════════════════════════════════════════════════════════════════
+    run_section("Fast Path - Trivial Shapes", {
+        {"GET /", "GET /", true, "Literal"},
+        {"GET /", "GET /x", false, "Literal rejects a longer line"},
+        {"\\d+", "2024", true, "Class with plus"},
+        {"\\d+", "", false, "Class with plus rejects the empty line"},
+        {"[a-z_]*", "", true, "Class with star accepts the empty line"},
+        {"[\\w\\s]*", "one two_three four five six seven eight", true, "Class longer than a block"},
+        {"[\\w\\s]*", "one two_three four five six seven-eight", false, "Byte outside the class in a block"},
+        {"ERROR.*", "ERROR: disk full", true, "Prefix"},
+        {"ERROR.*", "An ERROR", false, "Prefix must start the line"},
+        {".*\\.log", "server.log", true, "Suffix"},
+        {".*\\.log", "server.log.1", false, "Suffix must end the line"},
+        {".*ERROR.*", "An ERROR here", true, "Contains"},
+        {".*ERROR.*", "ERRO", false, "Contains rejects a partial literal"},
+    }, test_match, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: required literals for the prefilter
+    // ════════════════════════════════════════════════════════════════
+    run_section("Prefilter - Required Literals", {
+        {".*ERROR.*", {"ERROR"}, "Literal between wildcards"},
+        {"x*(foo|bar)\\d+", {"bar", "foo"}, "Alternation of literals"},
+        {"ab?c", {"abc", "ac"}, "Optional character"},
+        {"(a|b)(c|d)e", {"ace", "ade", "bce", "bde"}, "Small cross product"},
+        {"\\w+@\\w+\\.com", {".com"}, "Longest literal wins"},
+        {"abc|d.*", {"abc", "d"}, "Alternatives each require a literal"},
+        {".*", {}, "Nothing is required"},
+        {"abc|.*", {}, "An alternative requires nothing"},
+        {"(abc)*", {}, "Star may match nothing"},
+    }, test_literals, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: length bounds for the prefilter
+    // ════════════════════════════════════════════════════════════════
+    constexpr size_t unbounded = LengthBounds::unbounded;
+    run_section("Prefilter - Length Bounds", {
+        {"", 0, 0, "Empty regex"},
+        {"[A-Z][A-Z]\\d\\d\\d\\d\\d\\d", 8, 8, "Fixed-format ID"},
+        {"ab?c", 2, 3, "Optional character"},
+        {"(abc|d)e", 2, 4, "Alternatives of different lengths"},
+        {"a+", 1, unbounded, "Plus"},
+        {"x(ab)*y", 2, unbounded, "Star"},
+        {"()*", 0, 0, "Star of the empty string"},
+    }, test_length, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: lines the prefilter rejects
+    // ════════════════════════════════════════════════════════════════
+    run_section("Prefilter - Rejected Lines", {
+        {"\\d+x", "12y", false, "Wrong last byte"},
+        {"\\d+x", "a2x", false, "Wrong first byte"},
+        {"\\d+x", "a2x1x", false, "Wrong first byte, right last byte"},
+        {"\\d*x", "x", true, "First byte after an optional prefix"},
+        {"(ab)?c?", "", true, "Nullable regex passes the empty line"},
+        {"a", "", false, "Non-nullable regex rejects the empty line"},
+        {"[A-Z][A-Z]\\d\\d", "AB123", false, "Line too long"},
+        {".*ERROR.*", "an ERROR here", true, "Line with the required literal"},
+        {".*ERROR.*", "all fine", false, "Line without the required literal"},
+    }, test_prefilter, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: rewrites of the optimizer
+    // ════════════════════════════════════════════════════════════════
+    run_section("Optimizer - Rewrites", {
+        {"((ab))c", "abc", "Nested groups are flattened"},
+        {"(a*)*", "a*", "Nested stars"},
+        {"(a+)?", "a*", "Plus inside optional"},
+        {"a*a*b?b+", "a*b+", "Repeated pieces are merged"},
+        {"ab|ab", "ab", "Duplicate alternatives"},
+        {"a|\\d|[bc]", "[abc\\d]", "Single bytes are folded into a set"},
+        {"(a|b)|c", "[abc]", "Alternatives of a group are spliced in"},
+        {"abc|abd|x", "ab[cd]|x", "Common prefix"},
+        {"xa|ya", "[xy]a", "Common suffix"},
+        {"a|ab", "ab?", "An alternative is a prefix of another"},
+        {"aa|ab", "a[ab]", "Prefix of single bytes"},
+    }, test_optimize, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: the optimized regex matches exactly what the original one does
+    // ════════════════════════════════════════════════════════════════
+    run_section("Optimizer - Same Matches", {
+        {"((ab))c", "abc", 4, "Nested groups"},
+        {"(a*)*b", "ab", 6, "Nested stars"},
+        {"(a+)?(b?)+", "ab", 6, "Optional plus and plus of optional"},
+        {"a*a*b?b+", "ab", 6, "Merged pieces"},
+        {"a|\\d|[bc]", "ab1x", 2, "Single bytes folded into a set"},
+        {"abc|abd|x", "abcdx", 4, "Common prefix"},
+        {"xa|ya|a", "axy", 3, "Common suffix, with an alternative that is the suffix itself"},
+        {"a|ab|abc", "abc", 4, "Alternatives that are prefixes of each other"},
+        {"(ab|a)*b", "ab", 7, "Star over alternatives with a common prefix"},
+        {"(a|ab)(c|bcd)", "abcd", 5, "Prefixes on both sides of a concatenation"},
+        {"(|a)+b|a*", "ab", 6, "Empty alternative under a plus"},
+        {"[ab]|a*|b+", "abx", 5, "Set overlapping with stars"},
+        {"(a|b)*a(a|b)", "ab", 6, "Alternatives of single bytes under a star"},
+        {"x(a|b|)y|xy", "abxy", 4, "Empty alternative duplicated by another alternative"},
+    }, test_equivalence, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: round trips through the decompressor
+    // ════════════════════════════════════════════════════════════════
+    std::vector<DecompressCase> decompress_cases;
+    [[maybe_unused]] const auto add_decompress_cases = [&](const Compression compression, const std::string& name) {
+        decompress_cases.insert(decompress_cases.end(), {
+            {compression, {""}, name + ": empty input"},
+            {compression, {"no newline at the end"}, name + ": single line without a newline"},
+            {compression, {sample_lines(60000)}, name + ": input spanning several blocks"},
+            {compression, {sample_lines(10), "\n\n", sample_lines(30000)}, name + ": concatenated members"},
+        });
+    };
+#ifdef REGEXFE_HAVE_ZLIB
+    add_decompress_cases(Compression::Gzip, "gzip");
+#endif
+#ifdef REGEXFE_HAVE_ZSTD
+    add_decompress_cases(Compression::Zstd, "zstd");
+#endif
+    run_section("Decompression - Round Trips", decompress_cases, test_decompress, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: round trips through the binary result output
+    // ════════════════════════════════════════════════════════════════
+    run_section("Result Frames - Round Trips", {
+        {ResultFrameKind::Bitmap, 0, 1, false, "Bitmap of an empty file"},
+        {ResultFrameKind::Bitmap, 100, 3, false, "Bitmap within one word"},
+        {ResultFrameKind::Bitmap, 1200000, 3, false, "Bitmap spanning several frames"},
+        {ResultFrameKind::Bitmap, 1200000, 5, true, "Bitmap of chunks spanning several frames"},
+        {ResultFrameKind::Indices, 0, 1, false, "Indices of an empty file"},
+        {ResultFrameKind::Indices, 20000, 1, false, "Indices spanning several frames"},
+        {ResultFrameKind::Indices, 100000, 7, true, "Indices of chunks spanning several frames"},
+        {ResultFrameKind::Indices, 5000, 100000, true, "Indices of a single selected line"},
+    }, test_frames, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: output buffered and written in batches, or line by line
+    // ════════════════════════════════════════════════════════════════
+    run_section("Output - Batched Writes", {
+        {20, 100, false, "Short lines, held back until flushed"},
+        {100, 50000, false, "Output filling the buffers many times"},
+        {200000, 20, false, "Lines longer than a buffer block"},
+        {30, 100, true, "Line buffered"},
+        {100000, 5, true, "Line buffered lines longer than a buffer block"},
+    }, test_output, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: trees of files, scanned one by one or spread over a pool
+    // ════════════════════════════════════════════════════════════════
+    run_section("Scanning - Files and Directories", {
+        {{10, 0, 300, 50}, 0, "Files on the calling thread"},
+        {{10, 0, 300, 50, 7, 1, 2000, 40, 5}, 4, "Small files spread over the pool"},
+        {{100000, 20, 30, 40, 50, 60}, 4, "A large file split into chunks beside small files"},
+        {{100000, 100000, 10}, 2, "Large files on fewer workers than chunks"},
+        {{100000, 10}, 1, "A large file on a single worker"},
+    }, test_tree, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: lines of streams, which arrive in pieces of any size
+    // ════════════════════════════════════════════════════════════════
+    constexpr size_t unlimited = std::numeric_limits<size_t>::max();
+    run_section("Streams - Lines Across Reads", {
+        {"", {4}, unlimited, "Empty input"},
+        {sample_lines(20), {1 << 16}, unlimited, "Lines within one piece"},
+        {sample_lines(20), {1}, unlimited, "Every byte a piece of its own"},
+        {"a\nb\n\nc\n", {2}, unlimited, "Pieces ending right after a newline"},
+        {repeat("x", 10000) + "\nshort\n", {7}, unlimited, "Line spanning many pieces"},
+        {"\n\n\n", {1, 2}, unlimited, "Empty lines only"},
+        {"a\nlast", {3}, unlimited, "Last line without a newline, carried over"},
+        {"first\n" + repeat("y", 100), {64}, unlimited, "Last line without a newline, spanning pieces"},
+        {sample_lines(50), {5, 11, 3}, 10, "Stopping at a line assembled from pieces"},
+        {sample_lines(50), {1 << 16}, 3, "Stopping at a line within a piece"},
+    }, test_assembly, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: which lines are reported, and how
+    // ════════════════════════════════════════════════════════════════
+    const std::string few = "GET /a\nPOST /b\nGET /c\n\nGET /d";
+    // larger than a chunk of the pool
+    const std::string many = repeat("GET /a\nPOST /b\nGET /c\n\nGET /d\n", 100000);
+    run_section("Scanning - Output Modes", {
+        {"GET .*", few, {}, "GET /a,true\nPOST /b,false\nGET /c,true\n,false\nGET /d,true\n", true,
+         "Every line with its result"},
+        {"GET .*", few, {.selection = Selection::Matching}, "GET /a\nGET /c\nGET /d\n", true, "Matching lines"},
+        {"GET .*", few, {.selection = Selection::NonMatching}, "POST /b\n\n", true, "Non-matching lines"},
+        {"GET .*", few, {.selection = Selection::Matching, .label = LineLabel::Number}, "1\n3\n5\n", true,
+         "Numbers of matching lines"},
+        {"GET .*", few, {.selection = Selection::Matching, .label = LineLabel::ByteOffset}, "0\n15\n23\n", true,
+         "Offsets of matching lines"},
+        {"GET .*", few, {.selection = Selection::NonMatching, .label = LineLabel::ByteOffset}, "7\n22\n", true,
+         "Offsets of non-matching lines"},
+        {"GET .*", few, {.selection = Selection::Matching, .count = true}, "3\n", true, "Count of matching lines"},
+        {"GET .*", few, {.selection = Selection::NonMatching, .count = true}, "2\n", true,
+         "Count of non-matching lines"},
+        {"x.*", few, {.selection = Selection::Matching, .count = true}, "0\n", false, "Count of no lines"},
+        {"GET .*", few, {.quiet = true}, "", true, "Quiet with a matching line"},
+        {"x.*", few, {.quiet = true}, "", false, "Quiet without a matching line"},
+        {"GET .*", few, {.selection = Selection::Matching, .max_count = 2}, "GET /a\nGET /c\n", true,
+         "Maximum count of matching lines"},
+        {"GET .*", few, {.max_count = 1}, "GET /a,true\n", true, "Maximum count of every line with its result"},
+        {"GET .*", few, {.selection = Selection::NonMatching, .max_count = 1}, "POST /b\n", true,
+         "Maximum count of non-matching lines"},
+        {"GET .*", many, {.selection = Selection::Matching, .count = true}, "300000\n", true,
+         "Count over several chunks"},
+        {"GET .*", many, {.selection = Selection::Matching, .count = true, .max_count = 250000}, "250000\n", true,
+         "Count limited in a later chunk"},
+        {"GET .*", many, {.selection = Selection::Matching, .max_count = 250000},
+         repeat("GET /a\nGET /c\nGET /d\n", 83333) + "GET /a\n", true, "Maximum count reached in a later chunk"},
+        {"GET .*", many, {.selection = Selection::Matching, .label = LineLabel::Number, .max_count = 4},
+         "1\n3\n5\n6\n", true, "Numbers of the first matching lines"},
+        {"GET .*", many, {.quiet = true}, "", true, "Quiet over several chunks"},
+    }, test_scan_mode, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: the JIT compiles regexes into matchers like clang does
+    // ════════════════════════════════════════════════════════════════
+    std::vector<BackendCase> backend_cases;
+    if (MimirCodeGen::has_jit()) {
+        backend_cases = {
+            {"", {"", "a"}, "Empty regex"},
+            {"a(b|c)*d", {"ad", "abcbd", "abxd", "", "abcd d"}, "Spec example"},
+            {"\\d?\\d", {"7", "42", "123", ""}, "Optional digit"},
+            {"[^a-z\\d]+", {"A_!", "A1", "", "ZZZ"}, "Negated set with range and class"},
+            {"\\w+@\\w+\\.com", {"me@host.com", "me@host.org", "@host.com", "me@.com"}, "Word characters"},
+            {"(a|b)*a(a|b)(a|b)", {"aab", "babb", "ab", "bbbbaaa"}, "Star over alternatives"},
+            {".*ERROR.*", {"ERROR", "an ERROR here", "ERRO"}, "Literal between wildcards"},
+        };
+    }
+    run_section("Backends - JIT and Clang Agree", backend_cases, test_backends, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: options of the code generation, checked before anything is compiled
+    // ════════════════════════════════════════════════════════════════
+    run_section("Code Generation - Options", {
+        {2, "", "", false, true, "-O2", true, "Default options"},
+        {0, "", "", false, true, "-O0", true, "No optimization"},
+        {3, "", "generic", false, true, "-O3 -mtune=generic", true, "Full optimization, tuned"},
+        {-1, "", "", false, false, "-O-1", false, "Negative optimization level"},
+        {4, "", "", false, false, "-O4", false, "Optimization level above 3"},
+        {2, "no-such-cpu", "", false, true, "-O2 -march=no-such-cpu", false, "Unknown CPU, reported when compiling"},
+        {2, "", "", true, MimirCodeGen::has_jit(), "-O2", MimirCodeGen::has_jit(), "Bitcode, which needs LLVM"},
+    }, test_codegen_options, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: classes and bracket expressions, merged into one set of bytes
+    // ════════════════════════════════════════════════════════════════
+    run_section("Byte Sets - Classes and Brackets", {
+        {"a", {{'a', 'a'}}, "Literal"},
+        {".", {{0, 255}}, "Dot"},
+        {"\\d", {{'0', '9'}}, "Digit class"},
+        {"\\w", {{'0', '9'}, {'A', 'Z'}, {'_', '_'}, {'a', 'z'}}, "Word class"},
+        {"\\W", {{0, '/'}, {':', '@'}, {'[', '^'}, {'`', '`'}, {'{', 127}}, "Non-word class, within ASCII"},
+        {"\\s", {{'\t', '\r'}, {' ', ' '}}, "Whitespace class"},
+        {"[a-cb-e]", {{'a', 'e'}}, "Overlapping ranges are merged"},
+        {"[a-cd-f]", {{'a', 'f'}}, "Adjacent ranges are merged"},
+        {"[ca-b]", {{'a', 'c'}}, "Single characters are merged with ranges"},
+        {"[\\da-f\\dA-F]", {{'0', '9'}, {'A', 'F'}, {'a', 'f'}}, "Classes and ranges are sorted, repeats merged"},
+        {"[\\d\\D]", {{0, 127}}, "Class and its complement, within ASCII"},
+        {"[^a-z\\d]", {{0, '/'}, {':', '`'}, {'{', 255}}, "Negated range and class"},
+        {"[^\\W]", {{'0', '9'}, {'A', 'Z'}, {'_', '_'}, {'a', 'z'}, {128, 255}},
+         "Negated non-word class, with every byte above ASCII"},
+        {"[]a]", {{']', ']'}, {'a', 'a'}}, "Closing bracket first"},
+        {"[]-]", {{'-', '-'}, {']', ']'}}, "Closing bracket and minus"},
+        {"[^]]", {{0, '\\'}, {'^', 255}}, "Negated closing bracket"},
+    }, test_byte_set, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: ASTs in arenas of their own, which live as long as they are used
+    // ════════════════════════════════════════════════════════════════
+    run_section("Parser - AST Arenas", {
+        {"a(b|c)*d", false, "abcbd", true, "Small AST"},
+        {"a(b|c)*d", true, "abxd", false, "Small optimized AST"},
+        {"((ab))c|x*", true, "abc", true, "Optimized AST sharing nodes with the original one"},
+        {repeat("(ab|cd)[x-z]", 200), false, repeat("cdy", 200), true, "AST spanning many blocks of its arena"},
+        {repeat("(ab|cd)[x-z]", 200), true, repeat("cdy", 199) + "abw", false,
+         "Optimized AST spanning many blocks of its arena"},
+        {repeat("(", 300) + "a" + repeat(")", 300), false, "a", true, "Deeply nested groups"},
+    }, test_arena, result);
+
+    // ════════════════════════════════════════════════════════════════
+    // TEST: tokens lexed in place, up to the very end of the regex
+    // ════════════════════════════════════════════════════════════════
+    run_section("Lexer - Tokens in Place", {
+        {"", {}, std::nullopt, "Empty regex"},
+        {"ab", {Token(T_CHARACTER, 0, 'a'), Token(T_CHARACTER, 1, 'b')}, std::nullopt, "Characters"},
+        {"a|b*", {Token(T_CHARACTER, 0, 'a'), Token(T_OR, 1), Token(T_CHARACTER, 2, 'b'), Token(T_STAR, 3)},
+         std::nullopt, "Operators"},
+        {"(?:a)", {Token(T_LEFT_PARENTHESIS_QUESTION_MARK_COLON, 2), Token(T_CHARACTER, 3, 'a'),
+                   Token(T_RIGHT_PARENTHESIS, 4)}, std::nullopt, "Non-capturing group, at its last character"},
+        {"(?", {Token(T_LEFT_PARENTHESIS, 0), Token(T_QUESTION_MARK, 1)}, std::nullopt,
+         "Parenthesis and question mark at the end"},
+        {"\\d\\W", {Token(T_DIGIT_CHARS, 1), Token(T_NON_WORD_CHARS, 3)}, std::nullopt, "Classes"},
+        {"\\t\\n", {Token(T_SPECIAL_CHARACTER, 1, '\t'), Token(T_SPECIAL_CHARACTER, 3, '\n')}, std::nullopt,
+         "Escaped control characters"},
+        {"\\.", {Token(T_SPECIAL_CHARACTER, 1, '.')}, std::nullopt, "Escape at the end"},
+        {"a\\\\", {Token(T_CHARACTER, 0, 'a'), Token(T_SPECIAL_CHARACTER, 2, '\\')}, std::nullopt,
+         "Escaped backslash at the end"},
+        {"a\\", {Token(T_CHARACTER, 0, 'a')}, 1, "Backslash at the end"},
+        {"\\", {}, 0, "Only a backslash"},
+        {"ab\\q", {Token(T_CHARACTER, 0, 'a'), Token(T_CHARACTER, 1, 'b')}, 2, "Invalid escape"},
+        {"a\tb", {Token(T_CHARACTER, 0, 'a')}, 1, "Unprintable character"},
+    }, test_lex, result);
+
     // ════════════════════════════════════════════════════════════════
     // FINAL REPORT
     // ════════════════════════════════════════════════════════════════
@@ -0,0 +1,161 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+// the pool the current thread works for and its index in that pool, if any
+static thread_local const ThreadPool* current_pool = nullptr;
+static thread_local size_t current_index = 0;
+
+ThreadPool::ThreadPool(size_t worker_count) {
+
+    if (worker_count == 0) {
+        worker_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    queues.reserve(worker_count);
+
+    for (size_t i = 0; i < worker_count; i++) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    workers.reserve(worker_count);
+
+    for (size_t i = 0; i < worker_count; i++) {
+        workers.emplace_back([this, i] { worker_loop(i); });
+    }
+
+}
+
+ThreadPool::~ThreadPool() {
+
+    {
+        std::unique_lock lock(mutex);
+        idle.wait(lock, [this] { return unfinished == 0; });
+        stopping = true;
+    }
+
+    task_available.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+}
+
+void ThreadPool::submit(Task task) {
+
+    const size_t index = current_pool == this
+        ? current_index
+        : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+    {
+        std::lock_guard lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        queued++;
+        unfinished++;
+    }
+
+    task_available.notify_one();
+
+}
+
+void ThreadPool::wait_idle() {
+
+    std::unique_lock lock(mutex);
+    idle.wait(lock, [this] { return unfinished == 0; });
+
+    if (first_exception) {
+        std::exception_ptr exception = first_exception;
+        first_exception = nullptr;
+        std::rethrow_exception(exception);
+    }
+
+}
+
+bool ThreadPool::try_pop(const size_t index, Task& task) {
+
+    // own queue: newest task first
+    {
+        WorkerQueue& own = *queues[index];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // other queues: oldest task first
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        WorkerQueue& victim = *queues[(index + offset) % queues.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+
+}
+
+void ThreadPool::finish_task() {
+
+    bool now_idle;
+
+    {
+        std::lock_guard lock(mutex);
+        now_idle = --unfinished == 0;
+    }
+
+    if (now_idle) {
+        idle.notify_all();
+    }
+
+}
+
+void ThreadPool::worker_loop(const size_t index) {
+
+    current_pool = this;
+    current_index = index;
+
+    while (true) {
+
+        Task task;
+
+        {
+            std::unique_lock lock(mutex);
+            task_available.wait(lock, [this] { return stopping || queued > 0; });
+
+            if (queued == 0) {
+                return;
+            }
+
+            // reserve one of the queued tasks, so that every woken up worker finds one
+            queued--;
+        }
+
+        // the scan is not atomic, a concurrent scan may take the task this one would have found, hence retry
+        while (!try_pop(index, task)) {
+            std::this_thread::yield();
+        }
+
+        try {
+            task();
+        }
+        catch (...) {
+            std::lock_guard lock(mutex);
+            if (!first_exception) {
+                first_exception = std::current_exception();
+            }
+        }
+
+        finish_task();
+    }
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ThreadPool runs submitted tasks on a fixed number of worker threads, using work stealing.
+//
+// Every worker owns a queue of tasks. Tasks submitted by a task running on a worker go to that worker's queue,
+// where they are taken newest first. A worker whose queue is empty steals the oldest task of another worker.
+// Thus a task that splits a large piece of work into subtasks keeps its worker busy while the subtasks
+// spread over the idle workers, and no single large task can hold back the rest of the pool.
+class ThreadPool final {
+
+    using Task = std::function<void()>;
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+
+    // guards sleeping and waking up of workers and of threads waiting for the pool to become idle
+    std::mutex mutex;
+    std::condition_variable task_available;
+    std::condition_variable idle;
+
+    // number of tasks sitting in the queues
+    size_t queued = 0;
+    // number of tasks submitted but not finished yet
+    size_t unfinished = 0;
+    bool stopping = false;
+
+    std::exception_ptr first_exception;
+
+    // queue used for tasks submitted from outside the pool
+    std::atomic<size_t> next_queue = 0;
+
+    void worker_loop(size_t index);
+
+    bool try_pop(size_t index, Task& task);
+
+    void finish_task();
+
+public:
+    // Creates a pool with the given number of workers, 0 means one worker per hardware thread.
+    explicit ThreadPool(size_t worker_count);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Waits for all submitted tasks to finish.
+    ~ThreadPool();
+
+    [[nodiscard]] size_t size() const {
+        return workers.size();
+    }
+
+    // Runs task() on one of the workers. May be called from within a running task.
+    void submit(Task task);
+
+    // Blocks until every submitted task has finished, including tasks submitted in the meantime.
+    // Rethrows the first exception a task terminated with, if any.
+    void wait_idle();
+
+};
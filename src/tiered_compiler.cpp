@@ -0,0 +1,45 @@
+#include "tiered_compiler.hpp"
+
+TieredCompiler::TieredCompiler(std::shared_ptr<const Expression> expression,
+                               std::function<void(MimirCodeGen&)> configure)
+    : tiered(std::make_shared<LazyDfa>(expression->generatePikeProgram())) {
+
+    // setting up MimIR takes long as well, so all of it happens in the background
+    thread = std::thread([this, expression = std::move(expression), configure = std::move(configure)] {
+        try {
+            const auto generator = std::make_shared<MimirCodeGen>();
+            if (configure) {
+                configure(*generator);
+            }
+            {
+                std::lock_guard lock(mutex);
+                code_gen = generator;
+                if (cancelled) {
+                    generator->cancel();
+                }
+            }
+            const Matcher compiled = generator->make_matcher(expression->generateMatcherSource(*generator));
+            // the matcher of a regex too large to compile runs on a lazy DFA of its own
+            if (compiled.promoted()) {
+                tiered.promote(compiled);
+            }
+        }
+        catch (...) {
+            // the lazy DFA stays in charge
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+}
+
+TieredCompiler::~TieredCompiler() {
+    thread.join();
+}
+
+void TieredCompiler::cancel() {
+    std::lock_guard lock(mutex);
+    cancelled = true;
+    if (code_gen != nullptr) {
+        code_gen->cancel();
+    }
+}
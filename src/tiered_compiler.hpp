@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "ast.hpp"
+#include "lazy_dfa.hpp"
+#include "matcher.hpp"
+#include "mimir_codegen.hpp"
+
+// TieredCompiler makes a matcher available at once: the matcher starts out on the lazy DFA, while a background
+// thread compiles the regex to machine code, and switches to the compiled code once it is ready.
+// Short runs are thus done before the compilation would have been, and long runs still reach full speed.
+//
+// If the compilation fails, the matcher keeps using the lazy DFA, which gives the same results.
+class TieredCompiler final {
+
+    Matcher tiered;
+    std::atomic<bool> done = false;
+
+    // guards the code generator of the background thread, once it exists, and the request to cancel it
+    std::mutex mutex;
+    std::shared_ptr<MimirCodeGen> code_gen;
+    bool cancelled = false;
+
+    std::thread thread;
+
+public:
+    // configure is called on the MimirCodeGen of the background thread before it compiles the expression,
+    // e.g. to set its backend and cache.
+    explicit TieredCompiler(std::shared_ptr<const Expression> expression,
+                            std::function<void(MimirCodeGen&)> configure = {});
+
+    TieredCompiler(const TieredCompiler&) = delete;
+    TieredCompiler& operator=(const TieredCompiler&) = delete;
+
+    // Waits for the background thread, even after cancel, as compiling in the JIT cannot be interrupted.
+    ~TieredCompiler();
+
+    // The matcher, which can be copied and used right away.
+    [[nodiscard]] const Matcher& matcher() const {
+        return tiered;
+    }
+
+    // Whether the background thread has finished, i.e. either promoted the matcher or given up.
+    [[nodiscard]] bool finished() const {
+        return done.load(std::memory_order_acquire);
+    }
+
+    // Stops the compilation, see MimirCodeGen::cancel, and the matcher stays on the lazy DFA. Once it returns, no
+    // compiler process runs and no file of the compilation is left or written anymore, so the process may exit
+    // without destroying the TieredCompiler, e.g. with std::quick_exit, rather than wait for a compilation in the JIT.
+    void cancel();
+
+};
@@ -1,16 +1,21 @@
 #pragma once
 
-#include <string>
+#include <cstddef>
+#include <type_traits>
 
 class Token {
 
 public:
     int id = 0;
     size_t position = 0;
-    std::string payload;
+    // the character of a T_CHARACTER or T_SPECIAL_CHARACTER token, e.g. '\t' for "\t"
+    char character = '\0';
 
-    explicit Token(const int id, const size_t position, std::string payload = "") : id(id), position(position), payload(std::move(payload)) {}
+    explicit Token(const int id, const size_t position, const char character = '\0') : id(id), position(position), character(character) {}
 
     Token() = default;
 
-};
\ No newline at end of file
+};
+
+// tokens are passed around by value, without any allocation
+static_assert(std::is_trivially_copyable_v<Token>);